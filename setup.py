@@ -79,7 +79,12 @@ compile_arguments: List[str] = ['-flto']
 use_limited_api = False
 
 if environ.get('PYTHON_SDBUS_USE_LIMITED_API'):
-    c_macros.append(('Py_LIMITED_API', '0x03070000'))
+    c_macros.append(
+        (
+            'Py_LIMITED_API',
+            environ.get('PYTHON_SDBUS_LIMITED_API_VERSION', '0x03070000'),
+        )
+    )
     use_limited_api = True
 
 
@@ -146,8 +151,12 @@ if __name__ == '__main__':
                     'src/sdbus/sd_bus_internals_bus.c',
                     'src/sdbus/sd_bus_internals_creds.c',
                     'src/sdbus/sd_bus_internals_funcs.c',
+                    'src/sdbus/sd_bus_internals_future.c',
                     'src/sdbus/sd_bus_internals_interface.c',
+                    'src/sdbus/sd_bus_internals_json.c',
                     'src/sdbus/sd_bus_internals_message.c',
+                    'src/sdbus/sd_bus_internals_signature.c',
+                    'src/sdbus/sd_bus_internals_string_cache.c',
                 ],
                 extra_compile_args=compile_arguments,
                 extra_link_args=link_arguments,
@@ -19,6 +19,7 @@
 # Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 
 from .dbus_common_funcs import (
+    encode_value,
     get_default_bus,
     request_default_bus_name,
     request_default_bus_name_async,
@@ -114,7 +115,14 @@ from .sd_bus_internals import (
     DbusCredTypeUserSlice,
     DbusCredTypeUserUnit,
     DbusCredTypeWellKnownNames,
+    DbusDecodeColumnsFlag,
+    DbusDecodeLazyFlag,
+    DbusDecodeMemfdFlag,
+    DbusDecodeMemoryViewFlag,
+    DbusDecodeTypedArraysFlag,
+    DbusDecodeUnwrapVariantsFlag,
     DbusDeprecatedFlag,
+    DbusEncodeInferVariantsFlag,
     DbusHiddenFlag,
     DbusNoReplyFlag,
     DbusPropertyConstFlag,
@@ -125,21 +133,31 @@ from .sd_bus_internals import (
     DbusUnprivilegedFlag,
     SdBus,
     SdBusBaseError,
+    SdBusEncodedValue,
     SdBusLibraryError,
     SdBusUnmappedMessageError,
+    SealedMemfd,
     decode_object_path,
     encode_object_path,
+    get_string_cache_stats,
     map_exception_to_dbus_error,
+    register_struct_type,
     sd_bus_open,
     sd_bus_open_system,
     sd_bus_open_system_machine,
     sd_bus_open_system_remote,
     sd_bus_open_user,
     sd_bus_open_user_machine,
+    set_signature_decode_flags,
+    set_signature_encode_flags,
+    set_string_cache_size,
+    set_variant_int_signature,
 )
 
 __all__ = (
     'get_default_bus', 'request_default_bus_name',
+    'encode_value',
+    'SdBusEncodedValue',
     'request_default_bus_name_async', 'set_default_bus',
 
     'DbusAccessDeniedError', 'DbusAddressInUseError',
@@ -194,6 +212,21 @@ __all__ = (
     'DbusSensitiveFlag',
     'DbusUnprivilegedFlag',
 
+    'DbusDecodeTypedArraysFlag',
+    'DbusDecodeMemoryViewFlag',
+    'DbusDecodeMemfdFlag',
+    'SealedMemfd',
+    'DbusDecodeLazyFlag',
+    'DbusDecodeUnwrapVariantsFlag',
+    'DbusDecodeColumnsFlag',
+    'DbusEncodeInferVariantsFlag',
+    'set_signature_decode_flags',
+    'set_signature_encode_flags',
+    'set_variant_int_signature',
+    'set_string_cache_size',
+    'get_string_cache_stats',
+    'register_struct_type',
+
     "DbusCredTypePID",
     "DbusCredTypeTID",
     "DbusCredTypePPID",
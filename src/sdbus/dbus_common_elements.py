@@ -26,10 +26,13 @@ from typing import (
     Callable,
     Dict,
     List,
+    Mapping,
     Optional,
     Sequence,
     Tuple,
+    Type,
     TypeVar,
+    Union,
 )
 
 from .dbus_common_funcs import (
@@ -96,7 +99,9 @@ class DbusMethodCommon(DbusSomethingCommon):
             input_args_names: Sequence[str],
             result_signature: str,
             result_args_names: Sequence[str],
-            flags: int):
+            flags: int,
+            result_struct_types: Union[
+                Type[Any], Mapping[str, Type[Any]], None] = None):
 
         assert not isinstance(input_args_names, str), (
             "Passed a string as input args"
@@ -145,6 +150,17 @@ class DbusMethodCommon(DbusSomethingCommon):
         self.result_args_names = result_args_names
         self.flags = flags
 
+        if isinstance(result_struct_types, type):
+            assert result_signature.startswith('('), (
+                "Single struct type requires struct result signature. "
+                f"Signature: {result_signature}")
+            result_struct_types = {result_signature: result_struct_types}
+
+        self.result_struct_types: Optional[Dict[str, Type[Any]]] = (
+            dict(result_struct_types)
+            if result_struct_types
+            else None)
+
         self.__doc__ = original_method.__doc__
 
     def _rebuild_args(
@@ -22,7 +22,7 @@ from __future__ import annotations
 
 from asyncio import get_running_loop
 from contextvars import ContextVar
-from typing import Iterator
+from typing import Any, Iterator, Optional
 
 from .sd_bus_internals import (
     DbusPropertyConstFlag,
@@ -30,6 +30,7 @@ from .sd_bus_internals import (
     DbusPropertyEmitsInvalidationFlag,
     DbusPropertyExplicitFlag,
     SdBus,
+    SdBusEncodedValue,
     sd_bus_open,
 )
 
@@ -77,6 +78,16 @@ async def request_default_bus_name(
     default_bus.request_name(new_name, flags)
 
 
+def encode_value(
+        signature: str,
+        value: Any,
+        bus: Optional[SdBus] = None) -> SdBusEncodedValue:
+    if bus is None:
+        bus = get_default_bus()
+
+    return bus.new_encoded_value(signature, value)
+
+
 def _method_name_converter(python_name: str) -> Iterator[str]:
     char_iter = iter(python_name)
     # Name starting with upper case letter
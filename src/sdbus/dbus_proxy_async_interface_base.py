@@ -171,6 +171,7 @@ class DbusInterfaceBaseAsync(metaclass=DbusInterfaceMetaAsync):
         self._serving_object_path: Optional[str] = None
         self._local_signal_queues: \
             Dict[DbusSignalAsync[Any], List[weak_ref[Queue[Any]]]] = {}
+        self._decode_limits: Optional[Tuple[int, int, int, int]] = None
 
     async def start_serving(self,
                             object_path: str,
@@ -261,10 +262,26 @@ class DbusInterfaceBaseAsync(metaclass=DbusInterfaceMetaAsync):
                 else:
                     raise TypeError
 
+            if self._decode_limits is not None:
+                new_interface.set_decode_limits(*self._decode_limits)
+
             bus.add_interface(new_interface, object_path,
                               interface_name)
             self._activated_interfaces.append(new_interface)
 
+    def set_decode_limits(
+        self,
+        max_depth: int = 0,
+        max_elements: int = 0,
+        max_string_bytes: int = 0,
+        max_objects: int = 0,
+    ) -> None:
+        self._decode_limits = (
+            max_depth, max_elements, max_string_bytes, max_objects,
+        )
+        for interface in self._activated_interfaces:
+            interface.set_decode_limits(*self._decode_limits)
+
     def drop_from_dbus(self) -> None:
         self._attached_bus = None
         self._serving_object_path = None
@@ -20,14 +20,19 @@
 from __future__ import annotations
 
 from inspect import getmembers
-from typing import Any, Dict, List, Literal, Optional, Tuple
+from typing import Any, Dict, List, Literal, Optional, Tuple, cast
 
 from .dbus_common_funcs import get_default_bus
 from .dbus_proxy_async_interface_base import DbusInterfaceBaseAsync
-from .dbus_proxy_async_method import dbus_method_async
+from .dbus_proxy_async_method import DbusMethodAsyncBinded, dbus_method_async
 from .dbus_proxy_async_property import DbusPropertyAsyncBinded
 from .dbus_proxy_async_signal import dbus_signal_async
-from .sd_bus_internals import DbusPropertyEmitsChangeFlag, SdBus, SdBusSlot
+from .sd_bus_internals import (
+    DbusDecodeUnwrapVariantsFlag,
+    DbusPropertyEmitsChangeFlag,
+    SdBus,
+    SdBusSlot,
+)
 
 
 class DbusPeerInterfaceAsync(
@@ -91,10 +96,15 @@ class DbusPropertiesInterfaceAsync(
         properties: Dict[str, Any] = {}
 
         for interface_name in self._dbus_served_interfaces_names:
-            dbus_properties_data = await self._properties_get_all(
-                interface_name)
-
-            for member_name, variant in dbus_properties_data.items():
+            # Values are decoded without variant tuples
+            dbus_properties_data = await cast(
+                DbusMethodAsyncBinded, self._properties_get_all,
+            )._call_dbus_async(
+                interface_name,
+                decode_flags=DbusDecodeUnwrapVariantsFlag,
+            )
+
+            for member_name, value in dbus_properties_data.items():
                 try:
                     python_name = self._dbus_to_python_name_map[member_name]
                 except KeyError:
@@ -107,7 +117,7 @@ class DbusPropertiesInterfaceAsync(
                     else:
                         raise ValueError
 
-                properties[python_name] = variant[1]
+                properties[python_name] = value
 
         return properties
 
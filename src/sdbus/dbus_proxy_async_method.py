@@ -26,10 +26,12 @@ from typing import (
     TYPE_CHECKING,
     Any,
     Callable,
+    Mapping,
     Optional,
     Sequence,
     Type,
     TypeVar,
+    Union,
     cast,
 )
 from weakref import ref as weak_ref
@@ -79,7 +81,10 @@ class DbusMethodAsyncBinded(DbusBindedAsync):
 
         self.__doc__ = dbus_method.__doc__
 
-    async def _call_dbus_async(self, *args: Any) -> Any:
+    async def _call_dbus_async(
+            self, *args: Any,
+            decode_flags: Optional[int] = None,
+            timeout_usec: int = 0) -> Any:
         assert self.interface_ref is not None
         interface = self.interface_ref()
         assert interface is not None
@@ -100,16 +105,21 @@ class DbusMethodAsyncBinded(DbusBindedAsync):
             new_call_message.append_data(
                 self.dbus_method.input_signature, *args)
 
+        if timeout_usec:
+            new_call_message.timeout_usec = timeout_usec
+
         if self.dbus_method.flags & DbusNoReplyFlag:
             new_call_message.expect_reply = False
             new_call_message.send()
             return
 
-        reply_message = await interface._attached_bus.call_async(
-            new_call_message)
-        return reply_message.get_contents()
+        # Reply is decoded by the bus before the future is resolved
+        return await interface._attached_bus.call_async(
+            new_call_message, True,
+            decode_flags, self.dbus_method.result_struct_types)
 
-    def __call__(self, *args: Any, **kwargs: Any) -> Any:
+    def _call(self, timeout_usec: int,
+              args: Sequence[Any], kwargs: Mapping[str, Any]) -> Any:
         assert self.interface_ref is not None
         interface = self.interface_ref()
         assert interface is not None
@@ -127,11 +137,28 @@ class DbusMethodAsyncBinded(DbusBindedAsync):
                     *args,
                     **kwargs)
 
-            return self._call_dbus_async(*rebuilt_args)
+            return self._call_dbus_async(
+                *rebuilt_args, timeout_usec=timeout_usec)
         else:
             return self.dbus_method.original_method(
                 interface, *args, **kwargs)
 
+    def __call__(self, *args: Any, **kwargs: Any) -> Any:
+        return self._call(0, args, kwargs)
+
+    def call_with_timeout(
+            self, timeout: float, *args: Any, **kwargs: Any) -> Any:
+        """Call the method with a timeout in seconds
+
+        The timeout is enforced by sd-bus instead of the
+        bus default method call timeout.
+        """
+        timeout_usec = int(timeout * 1_000_000)
+        if timeout_usec <= 0:
+            raise ValueError(f"Timeout must be positive, got {timeout}")
+
+        return self._call(timeout_usec, args, kwargs)
+
     async def _call_method_from_dbus(
             self,
             request_message: SdBusMessage,
@@ -212,6 +239,8 @@ def dbus_method_async(
     result_args_names: Sequence[str] = (),
     input_args_names: Sequence[str] = (),
     method_name: Optional[str] = None,
+    result_struct_types: Union[
+        Type[Any], Mapping[str, Type[Any]], None] = None,
 ) -> Callable[[T_input], T_input]:
 
     assert not isinstance(input_signature, FunctionType), (
@@ -233,6 +262,7 @@ def dbus_method_async(
             result_args_names=result_args_names,
             input_args_names=input_args_names,
             flags=flags,
+            result_struct_types=result_struct_types,
         )
 
         return cast(T_input, new_wrapper)
@@ -40,7 +40,7 @@ from .dbus_common_elements import (
     DbusPropertyCommon,
     DbusSomethingAsync,
 )
-from .sd_bus_internals import SdBusMessage
+from .sd_bus_internals import DbusDecodeUnwrapVariantsFlag, SdBusMessage
 
 T = TypeVar('T')
 
@@ -132,10 +132,12 @@ class DbusPropertyAsyncBinded(DbusBindedAsync):
                 self.dbus_property.property_name,
             )
 
-        reply_message = await interface._attached_bus. \
-            call_async(new_call_message)
         # Get method returns variant but we only need contents of variant
-        return cast(T, reply_message.get_contents()[1])
+        return cast(
+            T,
+            await interface._attached_bus.call_async(
+                new_call_message, True, DbusDecodeUnwrapVariantsFlag),
+        )
 
     def _reply_get_sync(self, message: SdBusMessage) -> None:
         assert self.interface_ref is not None
@@ -19,10 +19,11 @@
 # Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 from __future__ import annotations
 
-from typing import Any, Dict, Literal, Tuple
+from typing import Any, Dict, Literal, Tuple, cast
 
 from .dbus_proxy_sync_interface_base import DbusInterfaceBase
-from .dbus_proxy_sync_method import dbus_method
+from .dbus_proxy_sync_method import DbusMethodSyncBinded, dbus_method
+from .sd_bus_internals import DbusDecodeUnwrapVariantsFlag
 
 
 class DbusPeerInterface(
@@ -68,9 +69,14 @@ class DbusPropertiesInterface(
         properties: Dict[str, Any] = {}
 
         for interface_name in self._dbus_served_interfaces_names:
-            dbus_properties_data = self._properties_get_all(
-                interface_name)
-            for member_name, variant in dbus_properties_data.items():
+            # Values are decoded without variant tuples
+            dbus_properties_data = cast(
+                DbusMethodSyncBinded, self._properties_get_all,
+            )._call_dbus_sync(
+                interface_name,
+                decode_flags=DbusDecodeUnwrapVariantsFlag,
+            )
+            for member_name, value in dbus_properties_data.items():
                 try:
                     python_name = self._dbus_to_python_name_map[member_name]
                 except KeyError:
@@ -83,7 +89,7 @@ class DbusPropertiesInterface(
                     else:
                         raise ValueError
 
-                properties[python_name] = variant[1]
+                properties[python_name] = value
 
         return properties
 
@@ -25,10 +25,12 @@ from typing import (
     TYPE_CHECKING,
     Any,
     Callable,
+    Mapping,
     Optional,
     Sequence,
     Type,
     TypeVar,
+    Union,
     cast,
 )
 
@@ -66,7 +68,9 @@ class DbusMethodSyncBinded(DbusBindedSync):
 
         self.__doc__ = dbus_method.__doc__
 
-    def _call_dbus_sync(self, *args: Any) -> Any:
+    def _call_dbus_sync(
+            self, *args: Any,
+            decode_flags: Optional[int] = None) -> Any:
         assert self.dbus_method.interface_name is not None
         new_call_message = self.interface._attached_bus. \
             new_method_call_message(
@@ -81,7 +85,8 @@ class DbusMethodSyncBinded(DbusBindedSync):
 
         reply_message = self.interface._attached_bus.call(
             new_call_message)
-        return reply_message.get_contents()
+        return reply_message.get_contents(
+            decode_flags, None, self.dbus_method.result_struct_types)
 
     def __call__(self, *args: Any, **kwargs: Any) -> Any:
         if len(args) == self.dbus_method.num_of_args:
@@ -103,6 +108,8 @@ def dbus_method(
     result_signature: str = "",
     flags: int = 0,
     method_name: Optional[str] = None,
+    result_struct_types: Union[
+        Type[Any], Mapping[str, Type[Any]], None] = None,
 ) -> Callable[[T_input], T_input]:
     assert not isinstance(input_signature, FunctionType), (
         "Passed function to decorator directly. "
@@ -123,6 +130,7 @@ def dbus_method(
             result_args_names=(),
             input_args_names=(),
             flags=flags,
+            result_struct_types=result_struct_types,
         )
 
         return cast(T_input, new_wrapper)
@@ -34,6 +34,7 @@ from typing import (
 
 from .dbus_common_elements import DbusPropertyCommon, DbusSomethingSync
 from .dbus_common_funcs import _check_sync_in_async_env
+from .sd_bus_internals import DbusDecodeUnwrapVariantsFlag
 
 T = TypeVar('T')
 
@@ -88,7 +89,9 @@ class DbusPropertySync(DbusPropertyCommon, DbusSomethingSync, Generic[T]):
 
         reply_message = obj._attached_bus. \
             call(new_call_message)
-        return cast(T, reply_message.get_contents()[1])
+        # Get method returns variant but we only need contents of variant
+        return cast(
+            T, reply_message.get_contents(DbusDecodeUnwrapVariantsFlag))
 
     def __set__(self, obj: DbusInterfaceBase, value: T) -> None:
         assert _check_sync_in_async_env(), (
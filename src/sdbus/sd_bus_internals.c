@@ -28,19 +28,38 @@ PyObject* exception_base = NULL;
 PyObject* exception_lib = NULL;
 PyObject* asyncio_get_running_loop = NULL;
 PyObject* asyncio_queue_class = NULL;
+PyObject* asyncio_cancelled_error = NULL;
+PyObject* asyncio_invalid_state_error = NULL;
 PyObject* is_coroutine_function = NULL;
+PyObject* signature_plan_cache = NULL;
+PyObject* signature_decode_flags_dict = NULL;
+PyObject* signature_encode_flags_dict = NULL;
+PyObject* array_array_class = NULL;
+PyObject* mmap_class = NULL;
+PyObject* struct_types_dict = NULL;
+PyObject* struct_type_fields_cache = NULL;
+PyObject* loop_buses_dict = NULL;
+PyObject* tuple_new_func = NULL;
+PyObject* dataclasses_fields_func = NULL;
+PyObject* keys_view_class = NULL;
+PyObject* values_view_class = NULL;
+PyObject* items_view_class = NULL;
 // Str objects
-PyObject* set_result_str = NULL;
-PyObject* set_exception_str = NULL;
 PyObject* put_no_wait_str = NULL;
 PyObject* add_reader_str = NULL;
 PyObject* remove_reader_str = NULL;
+PyObject* add_writer_str = NULL;
+PyObject* remove_writer_str = NULL;
 PyObject* empty_str = NULL;
 PyObject* null_str = NULL;
 PyObject* extend_str = NULL;
 PyObject* append_str = NULL;
 PyObject* call_soon_str = NULL;
+PyObject* call_at_str = NULL;
+PyObject* cancel_str = NULL;
 PyObject* create_task_str = NULL;
+PyObject* frombytes_str = NULL;
+PyObject* context_kwnames = NULL;
 
 // SdBusSlot
 
@@ -71,7 +90,16 @@ PyObject* SdBus_class = NULL;
 PyObject* SdBusCreds_class = NULL;
 PyObject* SdBusMessage_class = NULL;
 PyObject* SdBusSlot_class = NULL;
+PyObject* SdBusFuture_class = NULL;
 PyObject* SdBusInterface_class = NULL;
+PyObject* SdBusMessageArrayIterator_class = NULL;
+PyObject* SdBusEncodedValue_class = NULL;
+PyObject* SealedMemfd_class = NULL;
+PyObject* SdBusLazySequence_class = NULL;
+PyObject* SdBusLazyMapping_class = NULL;
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+PyObject* SdBusMessageBuffer_class = NULL;
+#endif
 
 #define SD_BUS_PY_INIT_TYPE_READY(type_slots)                                  \
         ({                                                                     \
@@ -100,12 +128,35 @@ PyMODINIT_FUNC PyInit_sd_bus_internals(void) {
         SdBusSlot_class = SD_BUS_PY_INIT_TYPE_READY(SdBusSlotType);
         SD_BUS_PY_INIT_ADD_OBJECT("SdBusSlot", SdBusSlot_class);
 
+        SdBusFuture_class = SD_BUS_PY_INIT_TYPE_READY(SdBusFutureType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusFuture", SdBusFuture_class);
+
         SdBusCreds_class = SD_BUS_PY_INIT_TYPE_READY(SdBusCredsType);
         SD_BUS_PY_INIT_ADD_OBJECT("SdBusCreds", SdBusCreds_class);
 
         SdBusInterface_class = SD_BUS_PY_INIT_TYPE_READY(SdBusInterfaceType);
         SD_BUS_PY_INIT_ADD_OBJECT("SdBusInterface", SdBusInterface_class);
 
+        SdBusMessageArrayIterator_class = SD_BUS_PY_INIT_TYPE_READY(SdBusMessageArrayIteratorType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusMessageArrayIterator", SdBusMessageArrayIterator_class);
+
+        SdBusEncodedValue_class = SD_BUS_PY_INIT_TYPE_READY(SdBusEncodedValueType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusEncodedValue", SdBusEncodedValue_class);
+
+        SealedMemfd_class = SD_BUS_PY_INIT_TYPE_READY(SealedMemfdType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SealedMemfd", SealedMemfd_class);
+
+        SdBusLazySequence_class = SD_BUS_PY_INIT_TYPE_READY(SdBusLazySequenceType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusLazySequence", SdBusLazySequence_class);
+
+        SdBusLazyMapping_class = SD_BUS_PY_INIT_TYPE_READY(SdBusLazyMappingType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusLazyMapping", SdBusLazyMapping_class);
+
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+        SdBusMessageBuffer_class = SD_BUS_PY_INIT_TYPE_READY(SdBusMessageBufferType);
+        SD_BUS_PY_INIT_ADD_OBJECT("SdBusMessageBuffer", SdBusMessageBuffer_class);
+#endif
+
         // Exception map
         dbus_error_to_exception_dict = CALL_PYTHON_AND_CHECK(PyDict_New());
         SD_BUS_PY_INIT_ADD_OBJECT("DBUS_ERROR_TO_EXCEPTION", dbus_error_to_exception_dict);
@@ -132,18 +183,53 @@ PyMODINIT_FUNC PyInit_sd_bus_internals(void) {
         asyncio_get_running_loop = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(asyncio_module, "get_running_loop"));
 
         asyncio_queue_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(asyncio_module, "Queue"));
+        asyncio_cancelled_error = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(asyncio_module, "CancelledError"));
+        asyncio_invalid_state_error = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(asyncio_module, "InvalidStateError"));
 
-        set_result_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("set_result"));
-        set_exception_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("set_exception"));
         put_no_wait_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("put_nowait"));
         call_soon_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("call_soon"));
+        call_at_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("call_at"));
+        cancel_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("cancel"));
         create_task_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("create_task"));
         remove_reader_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("remove_reader"));
         add_reader_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("add_reader"));
+        remove_writer_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("remove_writer"));
+        add_writer_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("add_writer"));
         empty_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(""));
         null_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromStringAndSize("\0", 1));
         extend_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("extend"));
         append_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("append"));
+        frombytes_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromString("frombytes"));
+        context_kwnames = CALL_PYTHON_AND_CHECK(Py_BuildValue("(s)", "context"));
+
+        CALL_PYTHON_EXPECT_NONE(_SdBusStringCache_set_size(SD_BUS_PY_STRING_CACHE_DEFAULT_SIZE));
+        signature_plan_cache = CALL_PYTHON_AND_CHECK(PyDict_New());
+        signature_decode_flags_dict = CALL_PYTHON_AND_CHECK(PyDict_New());
+        signature_encode_flags_dict = CALL_PYTHON_AND_CHECK(PyDict_New());
+
+        PyObject* array_module = CALL_PYTHON_AND_CHECK(PyImport_ImportModule("array"));
+        array_array_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(array_module, "array"));
+
+        PyObject* mmap_module = CALL_PYTHON_AND_CHECK(PyImport_ImportModule("mmap"));
+        mmap_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(mmap_module, "mmap"));
+
+        struct_types_dict = CALL_PYTHON_AND_CHECK(PyDict_New());
+        struct_type_fields_cache = CALL_PYTHON_AND_CHECK(PyDict_New());
+        loop_buses_dict = CALL_PYTHON_AND_CHECK(PyDict_New());
+        tuple_new_func = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString((PyObject*)&PyTuple_Type, "__new__"));
+        PyObject* dataclasses_module = CALL_PYTHON_AND_CHECK(PyImport_ImportModule("dataclasses"));
+        dataclasses_fields_func = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(dataclasses_module, "fields"));
+
+        PyObject* collections_abc_module = CALL_PYTHON_AND_CHECK(PyImport_ImportModule("collections.abc"));
+        keys_view_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(collections_abc_module, "KeysView"));
+        values_view_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(collections_abc_module, "ValuesView"));
+        items_view_class = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(collections_abc_module, "ItemsView"));
+        PyObject* sequence_abc CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(collections_abc_module, "Sequence"));
+        PyObject* mapping_abc CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(collections_abc_module, "Mapping"));
+        PyObject* registered_sequence CLEANUP_PY_OBJECT =
+            CALL_PYTHON_AND_CHECK(PyObject_CallMethod(sequence_abc, "register", "O", SdBusLazySequence_class));
+        PyObject* registered_mapping CLEANUP_PY_OBJECT =
+            CALL_PYTHON_AND_CHECK(PyObject_CallMethod(mapping_abc, "register", "O", SdBusLazyMapping_class));
 
         PyObject* inspect_module = CALL_PYTHON_AND_CHECK(PyImport_ImportModule("inspect"));
         is_coroutine_function = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(inspect_module, "iscoroutinefunction"));
@@ -158,6 +244,14 @@ PyMODINIT_FUNC PyInit_sd_bus_internals(void) {
         CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusPropertyExplicitFlag", SD_BUS_VTABLE_PROPERTY_EXPLICIT));
         CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusSensitiveFlag", SD_BUS_VTABLE_SENSITIVE));
 
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeTypedArraysFlag", SD_BUS_PY_DECODE_TYPED_ARRAYS));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeMemoryViewFlag", SD_BUS_PY_DECODE_MEMORY_VIEW));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeMemfdFlag", SD_BUS_PY_DECODE_MEMFD));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeLazyFlag", SD_BUS_PY_DECODE_LAZY));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeUnwrapVariantsFlag", SD_BUS_PY_DECODE_UNWRAP_VARIANTS));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusDecodeColumnsFlag", SD_BUS_PY_DECODE_COLUMNS));
+        CALL_PYTHON_INT_CHECK(PyModule_AddIntConstant(m, "DbusEncodeInferVariantsFlag", SD_BUS_PY_ENCODE_INFER_VARIANTS));
+
         CALL_PYTHON_AND_CHECK(_SdBusCreds_sdbus_module_init(m));
         Py_INCREF(m);
         return m;
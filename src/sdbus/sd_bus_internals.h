@@ -147,14 +147,21 @@
 #define SD_BUS_PY_BYTES_AS_CHAR_PTR(py_bytes) SD_BUS_PY_BYTES_AS_CHAR_PTR_ERROR_ACTION(py_bytes, return NULL)
 #define SD_BUS_PY_BYTES_AS_CHAR_PTR_GOTO_FAIL(py_bytes) SD_BUS_PY_BYTES_AS_CHAR_PTR_ERROR_ACTION(py_bytes, goto fail)
 
-#ifndef Py_LIMITED_API
-#define SD_BUS_PY_UNICODE_AS_CHAR_PTR_ERROR_ACTION(py_object, action)   \
-        ({                                                              \
-                const char* new_char_ptr = PyUnicode_AsUTF8(py_object); \
-                if (new_char_ptr == NULL) {                             \
-                        action;                                         \
-                }                                                       \
-                new_char_ptr;                                           \
+// Limited API 3.10 added METH_FASTCALL and PyUnicode_AsUTF8AndSize
+// which avoid building argument tuples and temporary bytes objects.
+#if !defined(Py_LIMITED_API) || Py_LIMITED_API + 0 >= 0x030A0000
+#define SD_BUS_PY_HAS_FASTCALL
+#define SD_BUS_PY_HAS_UNICODE_AS_UTF8
+#endif
+
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
+#define SD_BUS_PY_UNICODE_AS_CHAR_PTR_ERROR_ACTION(py_object, action)                 \
+        ({                                                                            \
+                const char* new_char_ptr = PyUnicode_AsUTF8AndSize(py_object, NULL); \
+                if (new_char_ptr == NULL) {                                           \
+                        action;                                                       \
+                }                                                                     \
+                new_char_ptr;                                                         \
         })
 
 #define SD_BUS_PY_UNICODE_AS_CHAR_PTR(py_object) SD_BUS_PY_UNICODE_AS_CHAR_PTR_ERROR_ACTION(py_object, return NULL)
@@ -208,13 +215,13 @@
         Py_DECREF(self_type);
 #endif
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 #define SD_BUS_PY_METH METH_FASTCALL
 #else
 #define SD_BUS_PY_METH METH_VARARGS
 #endif
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 #define SD_BUS_PY_FUNC_TYPE void*
 #else
 #define SD_BUS_PY_FUNC_TYPE PyCFunction
@@ -250,6 +257,22 @@
 #define SD_BUS_PY_LIST_GET_SIZE PyList_Size
 #endif
 
+// Buffer protocol is part of limited API since 3.11
+#if !defined(Py_LIMITED_API) || Py_LIMITED_API + 0 >= 0x030B0000
+#define SD_BUS_PY_HAS_BUFFER_API
+#endif
+
+// PyObject_Vectorcall is public since 3.9 and part of limited API since 3.12
+#if (!defined(Py_LIMITED_API) && PY_VERSION_HEX >= 0x03090000) || (defined(Py_LIMITED_API) && Py_LIMITED_API + 0 >= 0x030C0000)
+#define SD_BUS_PY_HAS_VECTORCALL
+#endif
+
+// PyMemoryView_FromMemory is part of limited API since 3.3
+// but its flags only got exposed in 3.11
+#ifndef PyBUF_READ
+#define PyBUF_READ 0x100
+#endif
+
 // Python functions and objects
 extern PyObject* unmapped_error_exception;
 extern PyObject* dbus_error_to_exception_dict;
@@ -258,19 +281,35 @@ extern PyObject* exception_base;
 extern PyObject* exception_lib;
 extern PyObject* asyncio_get_running_loop;
 extern PyObject* asyncio_queue_class;
+extern PyObject* asyncio_cancelled_error;
+extern PyObject* asyncio_invalid_state_error;
 extern PyObject* is_coroutine_function;
+extern PyObject* signature_plan_cache;
+extern PyObject* signature_decode_flags_dict;
+extern PyObject* signature_encode_flags_dict;
+extern PyObject* array_array_class;
+extern PyObject* mmap_class;
+extern PyObject* struct_types_dict;
+extern PyObject* struct_type_fields_cache;
+extern PyObject* loop_buses_dict;
+extern PyObject* tuple_new_func;
+extern PyObject* dataclasses_fields_func;
 // Str objects
-extern PyObject* set_result_str;
-extern PyObject* set_exception_str;
 extern PyObject* put_no_wait_str;
 extern PyObject* add_reader_str;
 extern PyObject* remove_reader_str;
+extern PyObject* add_writer_str;
+extern PyObject* remove_writer_str;
 extern PyObject* empty_str;
 extern PyObject* null_str;
 extern PyObject* extend_str;
 extern PyObject* append_str;
 extern PyObject* call_soon_str;
+extern PyObject* call_at_str;
+extern PyObject* cancel_str;
 extern PyObject* create_task_str;
+extern PyObject* frombytes_str;
+extern PyObject* context_kwnames;
 
 __attribute__((used)) static inline void _cleanup_char_ptr(const char** ptr) {
         if (*ptr != NULL) {
@@ -288,12 +327,53 @@ __attribute__((used)) static inline void _cleanup_pymem_char_array(const char***
 
 #define CLEANUP_PYMEM_STR_ARRAY __attribute__((cleanup(_cleanup_pymem_char_array)))
 
+__attribute__((used)) static inline void _cleanup_pymem_ptr(void** ptr) {
+        PyMem_Free(*ptr);
+}
+
+#define CLEANUP_PYMEM_PTR __attribute__((cleanup(_cleanup_pymem_ptr)))
+
 __attribute__((used)) static inline void PyObject_cleanup(PyObject** object) {
         Py_XDECREF(*object);
 }
 
 #define CLEANUP_PY_OBJECT __attribute__((cleanup(PyObject_cleanup)))
 
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+__attribute__((used)) static inline void PyBuffer_cleanup(Py_buffer* buffer) {
+        if (buffer->obj != NULL) {
+                PyBuffer_Release(buffer);
+        }
+}
+
+#define CLEANUP_PY_BUFFER __attribute__((cleanup(PyBuffer_cleanup)))
+#endif
+
+// Decode limits
+// Bound the work of decoding messages of untrusted peers. 0 disables a limit.
+typedef struct {
+        unsigned long max_depth;           // Nesting of arrays, structs and variants
+        unsigned long max_elements;        // Array elements and dict entries
+        unsigned long max_string_bytes;    // Bytes of strings and byte arrays
+        unsigned long max_objects;         // Python objects created
+} SdBusDecodeLimits;
+
+// Budget used by a decode of the message. Shared with the lazy views
+// and iterators it returned so that their reads count against the limits.
+typedef struct {
+        size_t elements_count;
+        size_t string_bytes;
+        size_t objects_count;
+} SdBusDecodeBudget;
+
+// Returns NULL if no limit is set
+extern const SdBusDecodeLimits* _SdBusDecodeLimits_or_null(const SdBusDecodeLimits* limits);
+#ifdef SD_BUS_PY_HAS_FASTCALL
+extern int _SdBusDecodeLimits_from_args(SdBusDecodeLimits* limits, PyObject* const* args, Py_ssize_t nargs);
+#else
+extern int _SdBusDecodeLimits_from_args(SdBusDecodeLimits* limits, PyObject* args);
+#endif
+
 // SdBusSlot
 typedef struct {
         PyObject_HEAD;
@@ -320,6 +400,9 @@ typedef struct {
         PyObject* property_set_dict;
         PyObject* signal_list;
         sd_bus_vtable* vtable;
+        // Limits of the interface or the bus it was added to if not set
+        SdBusDecodeLimits decode_limits;
+        PyObject* attached_bus;
 } SdBusInterfaceObject;
 
 extern PyType_Spec SdBusInterfaceType;
@@ -330,6 +413,13 @@ typedef struct {
         PyObject_HEAD;
         sd_bus_message* message_ref;
         uint64_t timeout_usec;
+        // Lazy view that last moved the read position and the index of
+        // its element the message is positioned at. Used to avoid
+        // rewinding on sequential access.
+        const void* lazy_cursor_owner;
+        Py_ssize_t lazy_cursor_index;
+        SdBusDecodeLimits decode_limits;
+        SdBusDecodeBudget decode_budget;
 } SdBusMessageObject;
 
 __attribute__((used)) static inline void cleanup_SdBusMessage(SdBusMessageObject** object) {
@@ -337,12 +427,64 @@ __attribute__((used)) static inline void cleanup_SdBusMessage(SdBusMessageObject
 }
 
 extern void _SdBusMessage_set_messsage(SdBusMessageObject* self, sd_bus_message* new_message);
+extern PyObject* _SdBusMessage_get_contents(SdBusMessageObject* self, PyObject* flags_object, PyObject* projection, PyObject* struct_types);
 
 #define CLEANUP_SD_BUS_MESSAGE __attribute__((cleanup(cleanup_SdBusMessage)))
 
 extern PyType_Spec SdBusMessageType;
 extern PyObject* SdBusMessage_class;
 
+// SdBusMessageArrayIterator
+// Decodes elements of the message array one at a time
+typedef struct {
+        PyObject_HEAD;
+        SdBusMessageObject* message;
+        PyObject* plan_capsule;
+        unsigned long flags;
+        int finished;
+} SdBusMessageArrayIteratorObject;
+
+extern PyType_Spec SdBusMessageArrayIteratorType;
+extern PyObject* SdBusMessageArrayIterator_class;
+
+// SdBusEncodedValue
+// Single complete value marshalled once in to a sealed scratch message
+// that is copied in to other messages.
+typedef struct {
+        PyObject_HEAD;
+        sd_bus_message* message_ref;
+        PyObject* signature;
+} SdBusEncodedValueObject;
+
+extern PyType_Spec SdBusEncodedValueType;
+extern PyObject* SdBusEncodedValue_class;
+
+extern PyObject* _SdBusEncodedValue_new(sd_bus* bus, PyObject* signature_str, PyObject* value_object);
+
+// SealedMemfd
+// Bytes like object to be sent as a sealed memfd in place of unix fd.
+typedef struct {
+        PyObject_HEAD;
+        PyObject* data;
+} SealedMemfdObject;
+
+extern PyType_Spec SealedMemfdType;
+extern PyObject* SealedMemfd_class;
+
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+// SdBusMessageBuffer
+// Exports memory of the message array as a read-only buffer
+typedef struct {
+        PyObject_HEAD;
+        sd_bus_message* message_ref;
+        const void* array_ptr;
+        size_t array_size;
+} SdBusMessageBufferObject;
+
+extern PyType_Spec SdBusMessageBufferType;
+extern PyObject* SdBusMessageBuffer_class;
+#endif
+
 // SdBusCreds
 typedef struct {
         PyObject_HEAD;
@@ -366,10 +508,137 @@ typedef struct {
         PyObject_HEAD;
         sd_bus* sd_bus_ref;
         PyObject* reader_fd;
+        PyObject* loop;    // Loop the reader is registered with
+        PyObject* timer_handle;  // Loop timer for the sd-bus timeouts
+        uint64_t timer_usec;     // Deadline the timer is armed for
+        int writer_registered;
+        PyObject* drain_waiters;  // List of (high_water, future) tuples
+        SdBusDecodeLimits decode_limits;
 } SdBusObject;
 
 extern PyType_Spec SdBusType;
 extern PyObject* SdBus_class;
 
+extern int _SdBus_wake_writer(sd_bus* bus);
+
+// SdBusFuture
+// Awaitable of the asynchronous calls implementing the asyncio Future protocol.
+typedef struct {
+        PyObject_HEAD;
+        sd_bus_slot* slot_ref;    // Pending call
+        PyObject* loop;
+        int state;
+        int blocking;    // _asyncio_future_blocking
+        PyObject* result;
+        PyObject* exception;
+        PyObject* cancel_message;
+        PyObject* callbacks;    // List of (callback, context) tuples or NULL
+        // Result of the successful reply instead of the reply message or NULL
+        PyObject* success_result;
+        // Reply is resolved to its contents if decode_flags is not NULL
+        PyObject* decode_flags;
+        PyObject* struct_types;
+} SdBusFutureObject;
+
+#define SD_BUS_PY_FUTURE_PENDING 0
+#define SD_BUS_PY_FUTURE_CANCELLED 1
+#define SD_BUS_PY_FUTURE_FINISHED 2
+
+__attribute__((used)) static inline void cleanup_SdBusFuture(SdBusFutureObject** object) {
+        Py_XDECREF(*object);
+}
+
+#define CLEANUP_SD_BUS_FUTURE __attribute__((cleanup(cleanup_SdBusFuture)))
+
+extern PyType_Spec SdBusFutureType;
+extern PyObject* SdBusFuture_class;
+
+extern SdBusFutureObject* _SdBusFuture_new(PyObject* loop);
+extern int _SdBusFuture_set_result(SdBusFutureObject* self, PyObject* result);
+extern int _SdBusFuture_set_exception(SdBusFutureObject* self, PyObject* exception);
+// Moves the raised Python exception in to the future
+extern int _SdBusFuture_set_exception_from_error(SdBusFutureObject* self);
+
 // Module level functions
 extern PyMethodDef SdBusPyInternal_methods[];
+
+// Signature plans
+#define SD_BUS_PY_MAX_SIGNATURE_LENGTH 256
+#define SD_BUS_PY_SIGNATURE_CACHE_MAX_SIZE 4096
+
+typedef struct {
+        char type;                // Basic type char or 'a', 'r', 'e', 'v'
+        const char* signature;    // Complete type signature of this node
+        const char* contents;     // Contents to open or enter container with. NULL for basic types and variants
+        size_t children_count;    // Number of direct children
+        size_t subtree_size;      // Number of nodes in subtree including this node
+} SdBusSignatureNode;
+
+typedef struct {
+        size_t nodes_count;
+        size_t top_level_count;
+        SdBusSignatureNode nodes[];
+} SdBusSignaturePlan;
+
+extern PyObject* _SdBusSignaturePlan_get(PyObject* signature_str);
+extern PyObject* _SdBusSignaturePlan_get_from_char_ptr(const char* signature_char_ptr);
+extern const SdBusSignaturePlan* _SdBusSignaturePlan_from_capsule(PyObject* plan_capsule);
+
+// JSON
+// Writes the message body from the current position as JSON bytes
+extern PyObject* _SdBusJson_dump_message(sd_bus_message* message, const SdBusSignaturePlan* plan);
+extern int _SdBusJson_load_message(sd_bus_message* message, const SdBusSignaturePlan* plan, const char* json_data, size_t json_length);
+
+// String cache
+#define SD_BUS_PY_STRING_CACHE_DEFAULT_SIZE 1024
+// Longer strings are not cached
+#define SD_BUS_PY_STRING_CACHE_MAX_LENGTH 256
+
+extern PyObject* _SdBusStringCache_get(const char* string);
+extern PyObject* _SdBusStringCache_set_size(size_t new_size);
+extern PyObject* _SdBusStringCache_get_stats(void);
+
+// Struct types
+// Returns borrowed tuple of NamedTuple or dataclass field names or None
+extern PyObject* _SdBusStructType_get_fields(PyObject* struct_type);
+
+// Decode flags
+#define SD_BUS_PY_DECODE_TYPED_ARRAYS (1UL << 0)
+#define SD_BUS_PY_DECODE_MEMORY_VIEW (1UL << 1)
+#define SD_BUS_PY_DECODE_MEMFD (1UL << 2)
+#define SD_BUS_PY_DECODE_LAZY (1UL << 3)
+#define SD_BUS_PY_DECODE_UNWRAP_VARIANTS (1UL << 4)
+#define SD_BUS_PY_DECODE_COLUMNS (1UL << 5)
+
+// Encode flags
+#define SD_BUS_PY_ENCODE_INFER_VARIANTS (1UL << 0)
+
+// Type of Python ints in variants with inferred signature
+extern char variant_inferred_int_type;
+
+// SdBusLazySequence and SdBusLazyMapping
+// Views of the message arrays and dicts that decode elements on access
+typedef struct {
+        const SdBusSignatureNode* node;    // Array node
+        Py_ssize_t index;                  // Index of the array in parent array or top level
+} SdBusLazyPathStep;
+
+typedef struct {
+        PyObject_HEAD;
+        SdBusMessageObject* message;
+        PyObject* plan_capsule;
+        unsigned long flags;
+        size_t path_depth;
+        SdBusLazyPathStep* path;
+        Py_ssize_t elements_count;    // -1 until counted
+        PyObject** elements;          // Memoized elements or values of dict entries
+        PyObject* keys_index;         // Dict key to entry index. Only for mappings.
+} SdBusLazyViewObject;
+
+extern PyType_Spec SdBusLazySequenceType;
+extern PyObject* SdBusLazySequence_class;
+extern PyType_Spec SdBusLazyMappingType;
+extern PyObject* SdBusLazyMapping_class;
+extern PyObject* keys_view_class;
+extern PyObject* values_view_class;
+extern PyObject* items_view_class;
@@ -19,20 +19,28 @@
 # Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 from __future__ import annotations
 
-from asyncio import Future, Queue
+from asyncio import AbstractEventLoop, Queue
+from contextvars import Context
 from typing import (
     Any,
     Callable,
     Coroutine,
     Dict,
+    Generator,
+    Generic,
+    Iterator,
     List,
+    Mapping,
     Optional,
     Sequence,
     Tuple,
     Type,
+    TypeVar,
     Union,
 )
 
+T = TypeVar('T')
+
 DbusBasicTypes = Union[str, int, bytes, float, Any]
 DbusStructType = Tuple[DbusBasicTypes, ...]
 DbusDictType = Dict[DbusBasicTypes, DbusBasicTypes]
@@ -53,6 +61,44 @@ class SdBusSlot:
     ...
 
 
+class SdBusFuture(Generic[T]):
+    """Future of the asynchronous D-Bus call
+
+    Implements the asyncio Future protocol.
+    """
+
+    def __await__(self) -> Generator[Any, None, T]:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def done(self) -> bool:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def cancelled(self) -> bool:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def result(self) -> T:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def exception(self) -> Optional[BaseException]:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def add_done_callback(
+            self, callback: Callable[[SdBusFuture[T]], object],
+            /, *, context: Optional[Context] = None) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def remove_done_callback(
+            self, callback: Callable[[SdBusFuture[T]], object],
+            /) -> int:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def cancel(self, msg: Optional[Any] = None) -> bool:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def get_loop(self) -> AbstractEventLoop:
+        raise NotImplementedError(__STUB_ERROR)
+
+
 class SdBusInterface:
     method_list: List[object]
     method_dict: Dict[bytes, object]
@@ -90,6 +136,15 @@ class SdBusInterface:
     ) -> None:
         raise NotImplementedError(__STUB_ERROR)
 
+    def set_decode_limits(
+        self,
+        max_depth: int,
+        max_elements: int,
+        max_string_bytes: int,
+        max_objects: int, /
+    ) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
 
 class SdBusMessage:
     def append_data(self, signature: str, *args: DbusCompleteTypes) -> None:
@@ -119,13 +174,38 @@ class SdBusMessage:
     ) -> None:
         raise NotImplementedError(__STUB_ERROR)
 
-    def get_contents(self
+    def get_contents(self, flags: Optional[int] = None,
+                     projection: Any = None,
+                     struct_types: Optional[Dict[str, type]] = None, /
                      ) -> Tuple[DbusCompleteTypes, ...]:
         raise NotImplementedError(__STUB_ERROR)
 
+    def get_contents_json(self) -> bytes:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def append_data_json(self, signature: str,
+                         json_data: Union[bytes, str], /) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def read_bytes_into(self, buffer: Any, /) -> int:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def iter_array(self, flags: Optional[int] = None, /
+                   ) -> Iterator[DbusCompleteTypes]:
+        raise NotImplementedError(__STUB_ERROR)
+
     def set_allow_interactive_authorization(self, allowed: bool) -> None:
         raise NotImplementedError(__STUB_ERROR)
 
+    def set_decode_limits(
+        self,
+        max_depth: int,
+        max_elements: int,
+        max_string_bytes: int,
+        max_objects: int, /
+    ) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
     def get_credentials(self) -> SdBusCreds:
         raise NotImplementedError(__STUB_ERROR)
 
@@ -151,6 +231,43 @@ class SdBusMessage:
     timeout_usec: int
 
 
+class SdBusLazySequence(Sequence[Any]):
+    def __getitem__(self, index: Any) -> Any:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def __len__(self) -> int:
+        raise NotImplementedError(__STUB_ERROR)
+
+
+class SdBusLazyMapping(Mapping[Any, Any]):
+    def __getitem__(self, key: Any) -> Any:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def __iter__(self) -> Any:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def __len__(self) -> int:
+        raise NotImplementedError(__STUB_ERROR)
+
+
+class SdBusEncodedValue:
+    @property
+    def signature(self) -> str:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def get_contents(self) -> DbusCompleteTypes:
+        raise NotImplementedError(__STUB_ERROR)
+
+
+class SealedMemfd:
+    def __init__(self, data: bytes) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
+    @property
+    def data(self) -> bytes:
+        raise NotImplementedError(__STUB_ERROR)
+
+
 class SdBusCreds:
 
     @property
@@ -296,7 +413,10 @@ class SdBus:
 
     def call_async(
             self, message: SdBusMessage,
-            /) -> Future[SdBusMessage]:
+            decode: bool = False,
+            decode_flags: Optional[int] = None,
+            struct_types: Optional[Dict[str, Type[Any]]] = None,
+            /) -> SdBusFuture[Any]:
         raise NotImplementedError(__STUB_ERROR)
 
     def drive(self) -> None:
@@ -334,6 +454,10 @@ class SdBus:
             /) -> SdBusMessage:
         raise NotImplementedError(__STUB_ERROR)
 
+    def new_encoded_value(self, signature: str, value: Any,
+                          /) -> SdBusEncodedValue:
+        raise NotImplementedError(__STUB_ERROR)
+
     def add_interface(self, new_interface: SdBusInterface,
                       object_path: str, interface_name: str, /) -> None:
         raise NotImplementedError(__STUB_ERROR)
@@ -343,10 +467,11 @@ class SdBus:
         senders_name: Optional[str], object_path: Optional[str],
         interface_name: Optional[str], member_name: Optional[str],
         /
-    ) -> Future[Queue[SdBusMessage]]:
+    ) -> SdBusFuture[Queue[SdBusMessage]]:
         raise NotImplementedError(__STUB_ERROR)
 
-    def request_name_async(self, name: str, flags: int, /) -> Future[None]:
+    def request_name_async(
+            self, name: str, flags: int, /) -> SdBusFuture[None]:
         raise NotImplementedError(__STUB_ERROR)
 
     def request_name(self, name: str, flags: int, /) -> None:
@@ -356,6 +481,13 @@ class SdBus:
     def unique_name(self) -> str:
         raise NotImplementedError(__STUB_ERROR)
 
+    @property
+    def n_queued_write(self) -> int:
+        raise NotImplementedError(__STUB_ERROR)
+
+    def drain(self, high_water: int = 0) -> SdBusFuture[None]:
+        raise NotImplementedError(__STUB_ERROR)
+
     def add_object_manager(self, path: str, /) -> SdBusSlot:
         raise NotImplementedError(__STUB_ERROR)
 
@@ -385,6 +517,15 @@ class SdBus:
     def get_creds_mask(self) -> int:
         raise NotImplementedError(__STUB_ERROR)
 
+    def set_decode_limits(
+        self,
+        max_depth: int,
+        max_elements: int,
+        max_string_bytes: int,
+        max_objects: int, /
+    ) -> None:
+        raise NotImplementedError(__STUB_ERROR)
+
 
 def sd_bus_open() -> SdBus:
     raise NotImplementedError(__STUB_ERROR)
@@ -427,6 +568,31 @@ def add_exception_mapping(exc: Exception, /) -> None:
     ...  # We want to be able to generate docs without module
 
 
+def set_signature_decode_flags(signature: str, flags: int, /) -> None:
+    raise NotImplementedError(__STUB_ERROR)
+
+
+def set_signature_encode_flags(signature: str, flags: int, /) -> None:
+    raise NotImplementedError(__STUB_ERROR)
+
+
+def set_variant_int_signature(signature: str, /) -> None:
+    raise NotImplementedError(__STUB_ERROR)
+
+
+def set_string_cache_size(size: int, /) -> None:
+    raise NotImplementedError(__STUB_ERROR)
+
+
+def get_string_cache_stats() -> Dict[str, int]:
+    raise NotImplementedError(__STUB_ERROR)
+
+
+def register_struct_type(signature: str,
+                         struct_type: Optional[type], /) -> None:
+    raise NotImplementedError(__STUB_ERROR)
+
+
 def is_interface_name_valid(string_to_check: str, /) -> bool:
     raise NotImplementedError(__STUB_ERROR)
 
@@ -469,6 +635,14 @@ DbusPropertyEmitsInvalidationFlag: int = 0
 DbusPropertyExplicitFlag: int = 0
 DbusSensitiveFlag: int = 0
 
+DbusDecodeTypedArraysFlag: int = 0
+DbusDecodeMemoryViewFlag: int = 0
+DbusDecodeMemfdFlag: int = 0
+DbusDecodeLazyFlag: int = 0
+DbusDecodeUnwrapVariantsFlag: int = 0
+DbusDecodeColumnsFlag: int = 0
+DbusEncodeInferVariantsFlag: int = 0
+
 
 DbusCredTypePID: int = 0
 DbusCredTypeTID: int = 0
@@ -19,12 +19,20 @@
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 */
 #include <errno.h>
+#include <poll.h>
 #include <systemd/sd-bus.h>
 #include "sd_bus_internals.h"
 
+static void _SdBus_forget_loop_bus(SdBusObject* self);
+
 static void SdBus_dealloc(SdBusObject* self) {
+        // Messages can keep the sd-bus alive after this object is gone
+        _SdBus_forget_loop_bus(self);
         sd_bus_unref(self->sd_bus_ref);
         Py_XDECREF(self->reader_fd);
+        Py_XDECREF(self->loop);
+        Py_XDECREF(self->timer_handle);
+        Py_XDECREF(self->drain_waiters);
 
         SD_BUS_DEALLOC_TAIL;
 }
@@ -34,7 +42,7 @@ static int SdBus_init(SdBusObject* self, PyObject* Py_UNUSED(args), PyObject* Py
         return 0;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusMessageObject* SdBus_new_method_call_message(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(4);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -64,7 +72,22 @@ static SdBusMessageObject* SdBus_new_method_call_message(SdBusObject* self, PyOb
         return new_message_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBus_new_encoded_value(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(2);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        PyObject* signature_str = args[0];
+        PyObject* value_object = args[1];
+#else
+static PyObject* SdBus_new_encoded_value(SdBusObject* self, PyObject* args) {
+        PyObject* signature_str = NULL;
+        PyObject* value_object = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "UO", &signature_str, &value_object, NULL));
+#endif
+        return _SdBusEncodedValue_new(self->sd_bus_ref, signature_str, value_object);
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusMessageObject* SdBus_new_property_get_message(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(4);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -97,7 +120,7 @@ static SdBusMessageObject* SdBus_new_property_get_message(SdBusObject* self, PyO
         return new_message_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusMessageObject* SdBus_new_property_set_message(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(4);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -130,7 +153,7 @@ static SdBusMessageObject* SdBus_new_property_set_message(SdBusObject* self, PyO
         return new_message_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusMessageObject* SdBus_new_signal_message(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(3);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);  // Path
@@ -156,7 +179,7 @@ static SdBusMessageObject* SdBus_new_signal_message(SdBusObject* self, PyObject*
         return new_message_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static int _check_sdbus_message(PyObject* something) {
         return PyType_IsSubtype(Py_TYPE(something), (PyTypeObject*)SdBusMessage_class);
 }
@@ -203,31 +226,40 @@ static SdBusMessageObject* SdBus_call(SdBusObject* self, PyObject* args) {
         return reply_message_object;
 }
 
-int future_set_exception_from_message(PyObject* future, sd_bus_message* message) {
+static PyObject* _exception_from_message(sd_bus_message* message) {
         const sd_bus_error* callback_error = sd_bus_message_get_error(message);
 
-        PyObject* error_name_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyUnicode_FromString(callback_error->name));
-        PyObject* error_message_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyUnicode_FromString(callback_error->message));
+        PyObject* error_name_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(callback_error->name));
+        PyObject* error_message_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(callback_error->message));
 
         PyObject* exception_to_raise = PyDict_GetItemWithError(dbus_error_to_exception_dict, error_name_str);
-
-        PyObject* exception_occurred = PyErr_Occurred();
-        if (exception_occurred) {
-                Py_XDECREF(CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(future, set_exception_str, exception_occurred, NULL)));
-                return 0;
-        }
+        PYTHON_ERR_OCCURED;
 
         if (exception_to_raise) {
-                PyObject* new_exception CLEANUP_PY_OBJECT =
-                    CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallFunctionObjArgs(exception_to_raise, error_message_str, NULL));
-                Py_XDECREF(CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(future, set_exception_str, new_exception, NULL)));
+                return PyObject_CallFunctionObjArgs(exception_to_raise, error_message_str, NULL);
         } else {
-                PyObject* new_exception CLEANUP_PY_OBJECT =
-                    CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallFunctionObjArgs(unmapped_error_exception, error_name_str, error_message_str, NULL));
-                Py_XDECREF(CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(future, set_exception_str, new_exception, NULL)));
+                return PyObject_CallFunctionObjArgs(unmapped_error_exception, error_name_str, error_message_str, NULL);
+        }
+}
+
+static int _future_resolve_from_reply(SdBusFutureObject* future, sd_bus_message* reply_message) {
+        if (sd_bus_message_is_method_error(reply_message, NULL)) {
+                PyObject* new_exception CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_exception_from_message(reply_message));
+                return _SdBusFuture_set_exception(future, new_exception);
+        }
+        if (future->success_result != NULL) {
+                return _SdBusFuture_set_result(future, future->success_result);
         }
 
-        return 0;
+        SdBusMessageObject* reply_message_object CLEANUP_SD_BUS_MESSAGE =
+            (SdBusMessageObject*)CALL_PYTHON_CHECK_RETURN_NEG1(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessage_class));
+        _SdBusMessage_set_messsage(reply_message_object, reply_message);
+        if (future->decode_flags == NULL) {
+                return _SdBusFuture_set_result(future, (PyObject*)reply_message_object);
+        }
+        PyObject* reply_contents CLEANUP_PY_OBJECT =
+            CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusMessage_get_contents(reply_message_object, future->decode_flags, Py_None, future->struct_types));
+        return _SdBusFuture_set_result(future, reply_contents);
 }
 
 static PyObject* SdBus_drive(SdBusObject* self, PyObject* Py_UNUSED(args));
@@ -252,12 +284,198 @@ PyObject* register_reader(SdBusObject* self) {
         Py_XDECREF(CALL_PYTHON_AND_CHECK(PyObject_CallMethodObjArgs(running_loop, add_reader_str, new_reader_fd, drive_method, NULL)));
         Py_INCREF(new_reader_fd);
         self->reader_fd = new_reader_fd;
+        // Futures of the calls are created on this loop
+        // without looking up the running loop every call.
+        Py_INCREF(running_loop);
+        Py_XDECREF(self->loop);
+        self->loop = running_loop;
+        // Lets messages sent with SdBusMessage.send find the bus
+        // to watch for writing. The pointer is borrowed so that the
+        // map does not keep the bus alive.
+        PyObject* bus_key CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyLong_FromVoidPtr(self->sd_bus_ref));
+        PyObject* bus_pointer CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyLong_FromVoidPtr(self));
+        CALL_PYTHON_INT_CHECK(PyDict_SetItem(loop_buses_dict, bus_key, bus_pointer));
         Py_RETURN_NONE;
 }
 
+static void _SdBus_forget_loop_bus(SdBusObject* self) {
+        // Removes the borrowed pointer added by register_reader.
+        // Called from dealloc so the current exception is preserved.
+        if (self->reader_fd == NULL || loop_buses_dict == NULL) {
+                return;
+        }
+        PyObject* exception_type = NULL;
+        PyObject* exception_value = NULL;
+        PyObject* exception_traceback = NULL;
+        PyErr_Fetch(&exception_type, &exception_value, &exception_traceback);
+        PyObject* bus_key = PyLong_FromVoidPtr(self->sd_bus_ref);
+        if (bus_key == NULL || PyDict_DelItem(loop_buses_dict, bus_key) < 0) {
+                PyErr_Clear();
+        }
+        Py_XDECREF(bus_key);
+        PyErr_Restore(exception_type, exception_value, exception_traceback);
+}
+
+static int _SdBus_cancel_timer(SdBusObject* self) {
+        PyObject* timer_handle CLEANUP_PY_OBJECT = self->timer_handle;
+        self->timer_handle = NULL;
+        if (timer_handle == NULL) {
+                return 0;
+        }
+        PyObject* should_be_none CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(timer_handle, cancel_str, NULL));
+        return 0;
+}
+
+static int _SdBus_update_timer(SdBusObject* self) {
+        // Keeps a single loop timer armed for the earliest sd-bus timeout.
+        // Timer armed for an earlier deadline is kept as is. When it fires
+        // it drives the bus and gets armed again for the next deadline.
+        // This avoids rearming the timer after every reply.
+        uint64_t timeout_usec = UINT64_MAX;
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_get_timeout(self->sd_bus_ref, &timeout_usec));
+        if (timeout_usec == UINT64_MAX) {
+                return 0;
+        }
+        if (self->timer_handle != NULL && self->timer_usec <= timeout_usec) {
+                return 0;
+        }
+
+        if (_SdBus_cancel_timer(self) < 0) {
+                return -1;
+        }
+        // Both sd-bus and asyncio loop use CLOCK_MONOTONIC
+        PyObject* timer_when CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyFloat_FromDouble((double)timeout_usec / 1e6));
+        PyObject* drive_timer_method CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_GetAttrString((PyObject*)self, "_drive_timer"));
+        self->timer_handle = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(self->loop, call_at_str, timer_when, drive_timer_method, NULL));
+        self->timer_usec = timeout_usec;
+        return 0;
+}
+
+static int _SdBus_get_n_queued_write(SdBusObject* self, uint64_t* queued_write) {
+        // Closed connection drops the queue without writing it
+        if (CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_is_open(self->sd_bus_ref)) == 0) {
+                PyErr_SetString(exception_lib, "Connection closed before the queued messages were written");
+                return -1;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_get_n_queued_write(self->sd_bus_ref, queued_write));
+        return 0;
+}
+
+static int _SdBus_fail_drain_waiters(SdBusObject* self) {
+        // Waiters get the error of reading the queue size
+        // as the queue is never going to be written.
+        PyObject* exception_type = NULL;
+        PyObject* exception_value = NULL;
+        PyObject* exception_traceback = NULL;
+        PyErr_Fetch(&exception_type, &exception_value, &exception_traceback);
+        PyErr_NormalizeException(&exception_type, &exception_value, &exception_traceback);
+        PyObject* drain_error CLEANUP_PY_OBJECT = exception_value;
+        Py_XDECREF(exception_type);
+        Py_XDECREF(exception_traceback);
+
+        PyObject* old_waiters CLEANUP_PY_OBJECT = self->drain_waiters;
+        self->drain_waiters = NULL;
+        Py_ssize_t waiters_count = SD_BUS_PY_LIST_GET_SIZE(old_waiters);
+        for (Py_ssize_t i = 0; i < waiters_count; ++i) {
+                PyObject* waiter_tuple = SD_BUS_PY_LIST_GET_ITEM(old_waiters, i);
+                SdBusFutureObject* waiter_future = (SdBusFutureObject*)SD_BUS_PY_TUPLE_GET_ITEM(waiter_tuple, 1);
+                if (waiter_future->state != SD_BUS_PY_FUTURE_PENDING) {
+                        // Cancelled
+                        continue;
+                }
+                if (_SdBusFuture_set_exception(waiter_future, drain_error) < 0) {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+static int _SdBus_resolve_drain_waiters(SdBusObject* self) {
+        if (self->drain_waiters == NULL || SD_BUS_PY_LIST_GET_SIZE(self->drain_waiters) == 0) {
+                return 0;
+        }
+        uint64_t queued_write = 0;
+        if (_SdBus_get_n_queued_write(self, &queued_write) < 0) {
+                return _SdBus_fail_drain_waiters(self);
+        }
+
+        PyObject* still_waiting CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyList_New(0));
+        Py_ssize_t waiters_count = SD_BUS_PY_LIST_GET_SIZE(self->drain_waiters);
+        for (Py_ssize_t i = 0; i < waiters_count; ++i) {
+                PyObject* waiter_tuple = SD_BUS_PY_LIST_GET_ITEM(self->drain_waiters, i);
+                SdBusFutureObject* waiter_future = (SdBusFutureObject*)SD_BUS_PY_TUPLE_GET_ITEM(waiter_tuple, 1);
+                if (waiter_future->state != SD_BUS_PY_FUTURE_PENDING) {
+                        // Cancelled
+                        continue;
+                }
+                uint64_t high_water = PyLong_AsUnsignedLongLong(SD_BUS_PY_TUPLE_GET_ITEM(waiter_tuple, 0));
+                if (queued_write <= high_water) {
+                        if (_SdBusFuture_set_result(waiter_future, Py_None) < 0) {
+                                return -1;
+                        }
+                } else {
+                        if (PyList_Append(still_waiting, waiter_tuple) < 0) {
+                                return -1;
+                        }
+                }
+        }
+
+        PyObject* old_waiters CLEANUP_PY_OBJECT = self->drain_waiters;
+        Py_INCREF(still_waiting);
+        self->drain_waiters = still_waiting;
+        return 0;
+}
+
+static int _SdBus_update_writer(SdBusObject* self) {
+        // Watch the socket for writing only while sd-bus
+        // has queued messages it could not write right away.
+        int events = sd_bus_get_events(self->sd_bus_ref);
+        int wants_write = events > 0 && (events & POLLOUT);
+        if (wants_write && !self->writer_registered) {
+                PyObject* drive_method CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_GetAttrString((PyObject*)self, "drive"));
+                PyObject* should_be_none CLEANUP_PY_OBJECT =
+                    CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(self->loop, add_writer_str, self->reader_fd, drive_method, NULL));
+                self->writer_registered = 1;
+        } else if (!wants_write && self->writer_registered) {
+                PyObject* should_be_bool CLEANUP_PY_OBJECT =
+                    CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallMethodObjArgs(self->loop, remove_writer_str, self->reader_fd, NULL));
+                self->writer_registered = 0;
+        }
+        return _SdBus_resolve_drain_waiters(self);
+}
+
+static int _SdBus_update_loop_events(SdBusObject* self) {
+        if (_SdBus_update_timer(self) < 0) {
+                return -1;
+        }
+        return _SdBus_update_writer(self);
+}
+
+int _SdBus_wake_writer(sd_bus* bus) {
+        // Message sent outside of the SdBus methods
+        // could not be written right away.
+        PyObject* bus_key CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyLong_FromVoidPtr(bus));
+        PyObject* bus_pointer = PyDict_GetItemWithError(loop_buses_dict, bus_key);
+        if (bus_pointer == NULL) {
+                // Bus is not attached to a loop
+                return PyErr_Occurred() ? -1 : 0;
+        }
+        SdBusObject* bus_object = PyLong_AsVoidPtr(bus_pointer);
+        if (bus_object == NULL) {
+                return -1;
+        }
+        return _SdBus_update_writer(bus_object);
+}
+
 PyObject* unregister_reader(SdBusObject* self) {
-        PyObject* running_loop CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL));
-        Py_XDECREF(CALL_PYTHON_AND_CHECK(PyObject_CallMethodObjArgs(running_loop, remove_reader_str, self->reader_fd, NULL)));
+        CALL_PYTHON_INT_CHECK(_SdBus_cancel_timer(self));
+        if (self->writer_registered) {
+                Py_XDECREF(CALL_PYTHON_AND_CHECK(PyObject_CallMethodObjArgs(self->loop, remove_writer_str, self->reader_fd, NULL)));
+                self->writer_registered = 0;
+        }
+        CALL_PYTHON_INT_CHECK(_SdBus_resolve_drain_waiters(self));
+        Py_XDECREF(CALL_PYTHON_AND_CHECK(PyObject_CallMethodObjArgs(self->loop, remove_reader_str, self->reader_fd, NULL)));
+        _SdBus_forget_loop_bus(self);
         Py_RETURN_NONE;
 }
 
@@ -282,70 +500,80 @@ static PyObject* SdBus_drive(SdBusObject* self, PyObject* Py_UNUSED(args)) {
                 }
         }
 
+        CALL_PYTHON_INT_CHECK(_SdBus_update_loop_events(self));
         Py_RETURN_NONE;
 }
 
+static PyObject* SdBus_drive_timer(SdBusObject* self, PyObject* Py_UNUSED(args)) {
+        // Timer has fired and the handle can not be cancelled anymore
+        Py_CLEAR(self->timer_handle);
+        return SdBus_drive(self, NULL);
+}
+
 int SdBus_async_callback(sd_bus_message* m,
-                         void* userdata,  // Should be the asyncio.Future
+                         void* userdata,  // Should be the SdBusFuture
                          sd_bus_error* Py_UNUSED(ret_error)) {
-        sd_bus_message* reply_message __attribute__((cleanup(sd_bus_message_unrefp))) = sd_bus_message_ref(m);
-        PyObject* py_future = userdata;
-        PyObject* is_cancelled CLEANUP_PY_OBJECT = PyObject_CallMethod(py_future, "cancelled", "");
-        if (Py_True == is_cancelled) {
-                // A bit unpythonic but SdBus_drive does not error out
+        SdBusFutureObject* future = userdata;
+        if (future->state != SD_BUS_PY_FUTURE_PENDING) {
+                // Cancelled
                 return 0;
         }
-
-        if (!sd_bus_message_is_method_error(m, NULL)) {
-                // Not Error, set Future result to new message object
-
-                SdBusMessageObject* reply_message_object CLEANUP_SD_BUS_MESSAGE = (SdBusMessageObject*)SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessage_class);
-                if (reply_message_object == NULL) {
-                        return -1;
-                }
-                _SdBusMessage_set_messsage(reply_message_object, reply_message);
-                PyObject* return_object CLEANUP_PY_OBJECT = PyObject_CallMethod(py_future, "set_result", "O", reply_message_object);
-                if (return_object == NULL) {
-                        return -1;
-                }
-        } else {
-                // An Error, set exception
-                if (future_set_exception_from_message(py_future, m) < 0) {
-                        return -1;
-                }
+        if (_future_resolve_from_reply(future, m) < 0) {
+                // Errors of decoding the reply are raised when awaited
+                // instead of being raised from the SdBus_drive.
+                return _SdBusFuture_set_exception_from_error(future);
         }
-
         return 0;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_call_async(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
-        SD_BUS_PY_CHECK_ARGS_NUMBER(1);
+        if (nargs < 1 || nargs > 4) {
+                PyErr_Format(PyExc_TypeError, "SdBus.call_async() takes 1-4 positional arguments but %zd were given", nargs);
+                return NULL;
+        }
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, _check_sdbus_message);
 
         SdBusMessageObject* call_message = (SdBusMessageObject*)args[0];
+        PyObject* decode_object = nargs > 1 ? args[1] : Py_False;
+        PyObject* decode_flags = nargs > 2 ? args[2] : Py_None;
+        PyObject* struct_types = nargs > 3 ? args[3] : Py_None;
 #else
 static PyObject* SdBus_call_async(SdBusObject* self, PyObject* args) {
         SdBusMessageObject* call_message = NULL;
-        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "O", &call_message, NULL));
+        PyObject* decode_object = Py_False;
+        PyObject* decode_flags = Py_None;
+        PyObject* struct_types = Py_None;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "O|OOO", &call_message, &decode_object, &decode_flags, &struct_types, NULL));
 #endif
-        PyObject* running_loop CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL));
-
-        PyObject* new_future = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(running_loop, "create_future", ""));
+        int decode = CALL_PYTHON_INT_CHECK(PyObject_IsTrue(decode_object));
+        if (struct_types != Py_None && !PyDict_Check(struct_types)) {
+                PyErr_Format(PyExc_TypeError, "Expected dict of struct types, got %R", struct_types);
+                return NULL;
+        }
 
-        SdBusSlotObject* new_slot_object CLEANUP_SD_BUS_SLOT = (SdBusSlotObject*)CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusSlot_class));
+        CHECK_SD_BUS_READER;
+        SdBusFutureObject* new_future CLEANUP_SD_BUS_FUTURE = _SdBusFuture_new(self->loop);
+        if (new_future == NULL) {
+                return NULL;
+        }
+        if (decode) {
+                // Reply is resolved directly to its contents
+                Py_INCREF(decode_flags);
+                new_future->decode_flags = decode_flags;
+                Py_INCREF(struct_types);
+                new_future->struct_types = struct_types;
+        }
 
         CALL_SD_BUS_AND_CHECK(
-            sd_bus_call_async(self->sd_bus_ref, &new_slot_object->slot_ref, call_message->message_ref, SdBus_async_callback, new_future, call_message->timeout_usec));
+            sd_bus_call_async(self->sd_bus_ref, &new_future->slot_ref, call_message->message_ref, SdBus_async_callback, new_future, call_message->timeout_usec));
+        CALL_PYTHON_INT_CHECK(_SdBus_update_loop_events(self));
 
-        if (PyObject_SetAttrString(new_future, "_sd_bus_py_slot", (PyObject*)new_slot_object) < 0) {
-                return NULL;
-        }
-        CHECK_SD_BUS_READER;
-        return new_future;
+        Py_INCREF(new_future);
+        return (PyObject*)new_future;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static int _check_is_sdbus_interface(PyObject* type_to_check) {
         return PyType_IsSubtype(Py_TYPE(type_to_check), (PyTypeObject*)SdBusInterface_class);
 }
@@ -373,6 +601,11 @@ static PyObject* SdBus_add_interface(SdBusObject* self, PyObject* args) {
         CALL_SD_BUS_AND_CHECK(sd_bus_add_object_vtable(self->sd_bus_ref, &interface_object->interface_slot->slot_ref, path_char_ptr, interface_name_char_ptr,
                                                        interface_object->vtable, interface_object));
 
+        // Interface uses decode limits of the bus unless it has its own
+        Py_INCREF(self);
+        Py_XDECREF(interface_object->attached_bus);
+        interface_object->attached_bus = (PyObject*)self;
+
         Py_RETURN_NONE;
 }
 
@@ -392,34 +625,27 @@ int _SdBus_signal_callback(sd_bus_message* m, void* userdata, sd_bus_error* Py_U
 }
 
 int _SdBus_match_signal_instant_callback(sd_bus_message* m, void* userdata, sd_bus_error* Py_UNUSED(ret_error)) {
-        PyObject* new_future = userdata;
+        SdBusFutureObject* future = userdata;
+        // Future result is the queue
+        PyObject* new_queue = future->success_result;
 
         if (!sd_bus_message_is_method_error(m, NULL)) {
-                PyObject* new_queue CLEANUP_PY_OBJECT = PyObject_GetAttrString(new_future, "_sd_bus_queue");
-                if (new_queue == NULL) {
-                        return -1;
-                }
-
-                PyObject* should_be_none CLEANUP_PY_OBJECT = PyObject_CallMethodObjArgs(new_future, set_result_str, new_queue, NULL);
-                if (should_be_none == NULL) {
-                        return -1;
-                }
-
                 SdBusSlotObject* slot_object CLEANUP_SD_BUS_SLOT = (SdBusSlotObject*)PyObject_GetAttrString(new_queue, "_sd_bus_slot");
                 if (slot_object == NULL) {
                         return -1;
                 }
                 sd_bus_slot_set_userdata(slot_object->slot_ref, new_queue);
-        } else {
-                if (future_set_exception_from_message(new_future, m) < 0) {
-                        return -1;
-                }
         }
-
+        if (future->state != SD_BUS_PY_FUTURE_PENDING) {
+                return 0;
+        }
+        if (_future_resolve_from_reply(future, m) < 0) {
+                return _SdBusFuture_set_exception_from_error(future);
+        }
         return 0;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 
 static int _unicode_or_none(PyObject* some_object) {
         return (PyUnicode_Check(some_object) || (Py_None == some_object));
@@ -453,49 +679,26 @@ static PyObject* SdBus_get_signal_queue(SdBusObject* self, PyObject* args) {
         // Bind lifetime of the slot to the queue
         CALL_PYTHON_INT_CHECK(PyObject_SetAttrString(new_queue, "_sd_bus_slot", (PyObject*)new_slot));
 
-        PyObject* running_loop CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL));
-
-        PyObject* new_future CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(running_loop, "create_future", ""));
+        CHECK_SD_BUS_READER;
+        SdBusFutureObject* new_future CLEANUP_SD_BUS_FUTURE = _SdBusFuture_new(self->loop);
+        if (new_future == NULL) {
+                return NULL;
+        }
 
         // Bind lifetime of the queue to future
-        CALL_PYTHON_INT_CHECK(PyObject_SetAttrString(new_future, "_sd_bus_queue", new_queue));
+        Py_INCREF(new_queue);
+        new_future->success_result = new_queue;
 
         CALL_SD_BUS_AND_CHECK(sd_bus_match_signal_async(self->sd_bus_ref, &new_slot->slot_ref, sender_service_char_ptr, path_name_char_ptr,
                                                         interface_name_char_ptr, member_name_char_ptr, _SdBus_signal_callback,
                                                         _SdBus_match_signal_instant_callback, new_future));
+        CALL_PYTHON_INT_CHECK(_SdBus_update_loop_events(self));
 
-        CHECK_SD_BUS_READER;
         Py_INCREF(new_future);
-        return new_future;
+        return (PyObject*)new_future;
 }
 
-int SdBus_request_callback(sd_bus_message* m,
-                           void* userdata,  // Should be the asyncio.Future
-                           sd_bus_error* Py_UNUSED(ret_error)) {
-        PyObject* py_future = userdata;
-        PyObject* is_cancelled CLEANUP_PY_OBJECT = PyObject_CallMethod(py_future, "cancelled", "");
-        if (Py_True == is_cancelled) {
-                // A bit unpythonic but SdBus_drive does not error out
-                return 0;
-        }
-
-        if (!sd_bus_message_is_method_error(m, NULL)) {
-                // Not Error, set Future result to new message object
-                PyObject* return_object CLEANUP_PY_OBJECT = PyObject_CallMethod(py_future, "set_result", "O", Py_None);
-                if (return_object == NULL) {
-                        return -1;
-                }
-        } else {
-                // An Error, set exception
-                if (future_set_exception_from_message(py_future, m) < 0) {
-                        return -1;
-                }
-        }
-
-        return 0;
-}
-
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_request_name_async(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -513,21 +716,23 @@ static PyObject* SdBus_request_name_async(SdBusObject* self, PyObject* args) {
         CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "sK", &service_name_char_ptr, &flags_long_long, NULL));
         uint64_t flags = (uint64_t)flags_long_long;
 #endif
-        PyObject* running_loop CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL));
-        PyObject* new_future = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(running_loop, "create_future", ""));
-        SdBusSlotObject* new_slot_object CLEANUP_SD_BUS_SLOT = (SdBusSlotObject*)CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusSlot_class));
+        CHECK_SD_BUS_READER;
+        SdBusFutureObject* new_future CLEANUP_SD_BUS_FUTURE = _SdBusFuture_new(self->loop);
+        if (new_future == NULL) {
+                return NULL;
+        }
+        Py_INCREF(Py_None);
+        new_future->success_result = Py_None;
 
         CALL_SD_BUS_AND_CHECK(
-            sd_bus_request_name_async(self->sd_bus_ref, &new_slot_object->slot_ref, service_name_char_ptr, flags, SdBus_request_callback, new_future));
+            sd_bus_request_name_async(self->sd_bus_ref, &new_future->slot_ref, service_name_char_ptr, flags, SdBus_async_callback, new_future));
+        CALL_PYTHON_INT_CHECK(_SdBus_update_loop_events(self));
 
-        if (PyObject_SetAttrString(new_future, "_sd_bus_py_slot", (PyObject*)new_slot_object) < 0) {
-                return NULL;
-        }
-        CHECK_SD_BUS_READER;
-        return new_future;
+        Py_INCREF(new_future);
+        return (PyObject*)new_future;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_request_name(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -549,7 +754,7 @@ static PyObject* SdBus_request_name(SdBusObject* self, PyObject* args) {
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusSlotObject* SdBus_add_object_manager(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -568,7 +773,7 @@ static SdBusSlotObject* SdBus_add_object_manager(SdBusObject* self, PyObject* ar
         return new_slot_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_emit_object_added(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -584,7 +789,7 @@ static PyObject* SdBus_emit_object_added(SdBusObject* self, PyObject* args) {
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_emit_object_removed(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -600,7 +805,7 @@ static PyObject* SdBus_emit_object_removed(SdBusObject* self, PyObject* args) {
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_emit_interfaces_added(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         if (nargs < 2) {
                 PyErr_SetString(PyExc_TypeError, "Minimum 2 args are required: object path and one interface");
@@ -612,7 +817,7 @@ static PyObject* SdBus_emit_interfaces_added(SdBusObject* self, PyObject* const*
         const char** interfaces CLEANUP_PYMEM_STR_ARRAY = PyMem_New(const char*, nargs);
         interfaces[nargs-1] = NULL;
         for (Py_ssize_t i = 1; i < nargs; ++i) {
-                const char* interface = PyUnicode_AsUTF8(args[i]);
+                const char* interface = PyUnicode_AsUTF8AndSize(args[i], NULL);
                 if (interface == NULL) {
                         goto sadtown;
                 }
@@ -644,7 +849,7 @@ sadtown:
         return PyErr_NoMemory();
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_emit_interfaces_removed(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         if (nargs < 2) {
                 PyErr_SetString(PyExc_TypeError, "Minimum 2 args are required: object path and one interface");
@@ -656,7 +861,7 @@ static PyObject* SdBus_emit_interfaces_removed(SdBusObject* self, PyObject* cons
         const char** interfaces CLEANUP_PYMEM_STR_ARRAY = PyMem_New(const char*, nargs);
         interfaces[nargs-1] = NULL;
         for (Py_ssize_t i = 1; i < nargs; ++i) {
-                const char* interface = PyUnicode_AsUTF8(args[i]);
+                const char* interface = PyUnicode_AsUTF8AndSize(args[i], NULL);
                 if (interface == NULL) {
                         goto sadtown;
                 }
@@ -688,7 +893,7 @@ sadtown:
         return PyErr_NoMemory();
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_set_method_call_timeout(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
@@ -704,7 +909,7 @@ static PyObject* SdBus_set_method_call_timeout(SdBusObject* self, PyObject* args
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_get_method_call_timeout(SdBusObject* self, PyObject* const* Py_UNUSED(args), Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(0);
 #else
@@ -716,7 +921,7 @@ static PyObject* SdBus_get_method_call_timeout(SdBusObject* self, PyObject* Py_U
         return PyLong_FromUnsignedLongLong(timeout_usecs);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_negotiate_creds(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyBool_Check);
@@ -733,7 +938,7 @@ static PyObject* SdBus_negotiate_creds(SdBusObject* self, PyObject* args) {
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBus_get_creds_mask(SdBusObject* self, PyObject* Py_UNUSED(args), Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(0);
 #else
@@ -744,8 +949,50 @@ static PyObject* SdBus_get_creds_mask(SdBusObject* self, PyObject* Py_UNUSED(arg
         return PyLong_FromUnsignedLongLong(mask);
 }
 
+static PyObject* SdBus_drain(SdBusObject* self, PyObject* args, PyObject* kwargs) {
+        static char* kwlist[] = {"high_water", NULL};
+        PyObject* high_water_object = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTupleAndKeywords(args, kwargs, "|O:drain", kwlist, &high_water_object));
+        uint64_t high_water = 0;
+        if (high_water_object != NULL) {
+                high_water = PyLong_AsUnsignedLongLong(high_water_object);
+                PYTHON_ERR_OCCURED;
+        }
+
+        CHECK_SD_BUS_READER;
+        SdBusFutureObject* new_future CLEANUP_SD_BUS_FUTURE = _SdBusFuture_new(self->loop);
+        if (new_future == NULL) {
+                return NULL;
+        }
+
+        uint64_t queued_write = 0;
+        CALL_PYTHON_INT_CHECK(_SdBus_get_n_queued_write(self, &queued_write));
+        if (queued_write <= high_water) {
+                CALL_PYTHON_INT_CHECK(_SdBusFuture_set_result(new_future, Py_None));
+                Py_INCREF(new_future);
+                return (PyObject*)new_future;
+        }
+
+        if (self->drain_waiters == NULL) {
+                self->drain_waiters = CALL_PYTHON_AND_CHECK(PyList_New(0));
+        }
+        PyObject* waiter_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(Py_BuildValue("(KO)", (unsigned long long)high_water, new_future));
+        CALL_PYTHON_INT_CHECK(PyList_Append(self->drain_waiters, waiter_tuple));
+        CALL_PYTHON_INT_CHECK(_SdBus_update_writer(self));
+
+        Py_INCREF(new_future);
+        return (PyObject*)new_future;
+}
+
 static PyObject* SdBus_close(SdBusObject* self, PyObject* Py_UNUSED(args)) {
+        if (self->reader_fd != NULL) {
+                // Loop callbacks hold references to the bus. Removed
+                // before closing as the loop still watches the socket.
+                CALL_PYTHON_EXPECT_NONE(unregister_reader(self));
+        }
         sd_bus_close(self->sd_bus_ref);
+        // Queued messages were dropped
+        CALL_PYTHON_INT_CHECK(_SdBus_resolve_drain_waiters(self));
         Py_RETURN_NONE;
 }
 
@@ -754,10 +1001,21 @@ static PyObject* SdBus_start(SdBusObject* self, PyObject* Py_UNUSED(args)) {
         Py_RETURN_NONE;
 }
 
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBus_set_decode_limits(SdBusObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args, nargs));
+#else
+static PyObject* SdBus_set_decode_limits(SdBusObject* self, PyObject* args) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args));
+#endif
+        Py_RETURN_NONE;
+}
+
 static PyMethodDef SdBus_methods[] = {
     {"call", (SD_BUS_PY_FUNC_TYPE)SdBus_call, SD_BUS_PY_METH, "Send message and get reply"},
     {"call_async", (SD_BUS_PY_FUNC_TYPE)SdBus_call_async, SD_BUS_PY_METH, "Async send message, returns awaitable future"},
     {"drive", (PyCFunction)SdBus_drive, METH_NOARGS, "Drive connection"},
+    {"_drive_timer", (PyCFunction)SdBus_drive_timer, METH_NOARGS, "Drive connection when the sd-bus timeout expires"},
     {"get_fd", (SD_BUS_PY_FUNC_TYPE)SdBus_get_fd, SD_BUS_PY_METH, "Get file descriptor to await on"},
     {"new_method_call_message", (SD_BUS_PY_FUNC_TYPE)SdBus_new_method_call_message, SD_BUS_PY_METH, NULL},
     {"new_property_get_message", (SD_BUS_PY_FUNC_TYPE)SdBus_new_property_get_message, SD_BUS_PY_METH, NULL},
@@ -765,6 +1023,7 @@ static PyMethodDef SdBus_methods[] = {
      "Set object/interface property. User must add variant data to "
      "message"},
     {"new_signal_message", (SD_BUS_PY_FUNC_TYPE)SdBus_new_signal_message, SD_BUS_PY_METH, "Create new signal message. User must data to message and send it"},
+    {"new_encoded_value", (SD_BUS_PY_FUNC_TYPE)SdBus_new_encoded_value, SD_BUS_PY_METH, "Encode value once to be appended to messages"},
     {"add_interface", (SD_BUS_PY_FUNC_TYPE)SdBus_add_interface, SD_BUS_PY_METH, "Add interface to the bus"},
     {"get_signal_queue_async", (SD_BUS_PY_FUNC_TYPE)SdBus_get_signal_queue, SD_BUS_PY_METH,
      "Returns a future that returns a queue that queues signal "
@@ -781,6 +1040,9 @@ static PyMethodDef SdBus_methods[] = {
     {"negotiate_creds", (SD_BUS_PY_FUNC_TYPE)SdBus_negotiate_creds, SD_BUS_PY_METH,
      "Specify a mask of credentials to automatically attach to incoming messages"},
     {"get_creds_mask", (SD_BUS_PY_FUNC_TYPE)SdBus_get_creds_mask, SD_BUS_PY_METH, "Get the current negotiated credentials mask"},
+    {"set_decode_limits", (SD_BUS_PY_FUNC_TYPE)SdBus_set_decode_limits, SD_BUS_PY_METH, "Set limits of decoding method calls and property sets of exported interfaces"},
+    {"drain", (PyCFunction)(void (*)(void))SdBus_drain, METH_VARARGS | METH_KEYWORDS,
+     "Returns a future that completes when the outgoing queue is at or below the high water mark"},
     {"close", (PyCFunction)SdBus_close, METH_NOARGS, "Close connection"},
     {"start", (PyCFunction)SdBus_start, METH_NOARGS, "Start connection"},
     {NULL, NULL, 0, NULL},
@@ -805,9 +1067,16 @@ static PyObject* SdBus_unique_name_getter(SdBusObject* self, void* Py_UNUSED(clo
         return PyUnicode_FromString(unique_name);
 }
 
+static PyObject* SdBus_n_queued_write_getter(SdBusObject* self, void* Py_UNUSED(closure)) {
+        uint64_t queued_write = 0;
+        CALL_SD_BUS_AND_CHECK(sd_bus_get_n_queued_write(self->sd_bus_ref, &queued_write));
+        return PyLong_FromUnsignedLongLong(queued_write);
+}
+
 static PyGetSetDef SdBus_properties[] = {
     {"address", (getter)SdBus_address_getter, NULL, "Bus address", NULL},
     {"unique_name", (getter)SdBus_unique_name_getter, NULL, "Get the unique name of the bus object on the bus", NULL},
+    {"n_queued_write", (getter)SdBus_n_queued_write_getter, NULL, "Number of messages waiting to be written to the socket", NULL},
     {0},
 };
 
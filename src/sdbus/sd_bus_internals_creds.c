@@ -292,7 +292,7 @@ static PyObject* SdBusCreds_get_owner_uid(SdBusCredsObject* self, PyObject* Py_U
         return PyLong_FromUnsignedLong(out);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusCreds_has_effective_cap(SdBusCredsObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
@@ -309,7 +309,7 @@ static PyObject* SdBusCreds_has_effective_cap(SdBusCredsObject* self, PyObject*
         return PyBool_FromLong(result);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusCreds_has_permitted_cap(SdBusCredsObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
@@ -326,7 +326,7 @@ static PyObject* SdBusCreds_has_permitted_cap(SdBusCredsObject* self, PyObject*
         return PyBool_FromLong(result);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusCreds_has_inheritable_cap(SdBusCredsObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
@@ -343,7 +343,7 @@ static PyObject* SdBusCreds_has_inheritable_cap(SdBusCredsObject* self, PyObject
         return PyBool_FromLong(result);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusCreds_has_bounding_cap(SdBusCredsObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
@@ -70,7 +70,7 @@ static SdBusObject* sd_bus_py_open_user_machine(PyObject* Py_UNUSED(self), PyObj
 #endif
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* encode_object_path(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -103,7 +103,7 @@ static PyObject* encode_object_path(PyObject* Py_UNUSED(self), PyObject* args) {
 #endif
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* decode_object_path(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -129,7 +129,7 @@ static PyObject* decode_object_path(PyObject* Py_UNUSED(self), PyObject* args) {
         }
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* map_exception_to_dbus_error(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyExceptionClass_Check);
@@ -154,7 +154,7 @@ static PyObject* map_exception_to_dbus_error(PyObject* Py_UNUSED(self), PyObject
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* add_exception_mapping(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         PyObject* exception = args[0];
@@ -181,7 +181,157 @@ static PyObject* add_exception_mapping(PyObject* Py_UNUSED(self), PyObject* args
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* set_signature_decode_flags(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(2);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(1, PyLong_Check);
+        PyObject* signature_str = args[0];
+        PyObject* flags = args[1];
+#else
+static PyObject* set_signature_decode_flags(PyObject* Py_UNUSED(self), PyObject* args) {
+        PyObject* signature_str = NULL;
+        PyObject* flags = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "UO!", &signature_str, &PyLong_Type, &flags, NULL));
+#endif
+        unsigned long flags_value = PyLong_AsUnsignedLong(flags);
+        PYTHON_ERR_OCCURED;
+
+        // Compile the signature to catch invalid ones early
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+
+        if (flags_value == 0) {
+                if (PyDict_DelItem(signature_decode_flags_dict, signature_str) < 0) {
+                        if (!PyErr_ExceptionMatches(PyExc_KeyError)) {
+                                return NULL;
+                        }
+                        PyErr_Clear();
+                }
+        } else {
+                CALL_PYTHON_INT_CHECK(PyDict_SetItem(signature_decode_flags_dict, signature_str, flags));
+        }
+
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* set_signature_encode_flags(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(2);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(1, PyLong_Check);
+        PyObject* signature_str = args[0];
+        PyObject* flags = args[1];
+#else
+static PyObject* set_signature_encode_flags(PyObject* Py_UNUSED(self), PyObject* args) {
+        PyObject* signature_str = NULL;
+        PyObject* flags = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "UO!", &signature_str, &PyLong_Type, &flags, NULL));
+#endif
+        unsigned long flags_value = PyLong_AsUnsignedLong(flags);
+        PYTHON_ERR_OCCURED;
+
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+
+        if (flags_value == 0) {
+                if (PyDict_DelItem(signature_encode_flags_dict, signature_str) < 0) {
+                        if (!PyErr_ExceptionMatches(PyExc_KeyError)) {
+                                return NULL;
+                        }
+                        PyErr_Clear();
+                }
+        } else {
+                CALL_PYTHON_INT_CHECK(PyDict_SetItem(signature_encode_flags_dict, signature_str, flags));
+        }
+
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* set_variant_int_signature(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(1);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        const char* int_signature = SD_BUS_PY_UNICODE_AS_CHAR_PTR(args[0]);
+#else
+static PyObject* set_variant_int_signature(PyObject* Py_UNUSED(self), PyObject* args) {
+        const char* int_signature = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "s", &int_signature, NULL));
+#endif
+        if (int_signature[0] == '\0' || int_signature[1] != '\0' || strchr("ynqiuxt", int_signature[0]) == NULL) {
+                PyErr_Format(PyExc_ValueError, "Expected integer type signature, got \"%s\"", int_signature);
+                return NULL;
+        }
+        variant_inferred_int_type = int_signature[0];
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* set_string_cache_size(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(1);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyLong_Check);
+        size_t new_size = PyLong_AsSize_t(args[0]);
+#else
+static PyObject* set_string_cache_size(PyObject* Py_UNUSED(self), PyObject* args) {
+        PyObject* size_object = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "O!", &PyLong_Type, &size_object, NULL));
+        size_t new_size = PyLong_AsSize_t(size_object);
+#endif
+        PYTHON_ERR_OCCURED;
+        return _SdBusStringCache_set_size(new_size);
+}
+
+static PyObject* get_string_cache_stats(PyObject* Py_UNUSED(self), PyObject* Py_UNUSED(args)) {
+        return _SdBusStringCache_get_stats();
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* register_struct_type(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(2);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        PyObject* signature_str = args[0];
+        PyObject* struct_type = args[1];
+#else
+static PyObject* register_struct_type(PyObject* Py_UNUSED(self), PyObject* args) {
+        PyObject* signature_str = NULL;
+        PyObject* struct_type = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "UO", &signature_str, &struct_type, NULL));
+#endif
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        if (plan->top_level_count != 1 || plan->nodes[0].type != 'r') {
+                PyErr_Format(PyExc_TypeError, "Expected single struct signature, got %R", signature_str);
+                return NULL;
+        }
+
+        if (struct_type == Py_None) {
+                if (PyDict_DelItem(struct_types_dict, signature_str) < 0) {
+                        if (!PyErr_ExceptionMatches(PyExc_KeyError)) {
+                                return NULL;
+                        }
+                        PyErr_Clear();
+                }
+                Py_RETURN_NONE;
+        }
+
+        if (!PyType_Check(struct_type)) {
+                PyErr_Format(PyExc_TypeError, "Expected NamedTuple or dataclass type, got %R", struct_type);
+                return NULL;
+        }
+        PyObject* struct_fields = CALL_PYTHON_AND_CHECK(_SdBusStructType_get_fields(struct_type));
+        if (struct_fields == Py_None) {
+                PyErr_Format(PyExc_TypeError, "Expected NamedTuple or dataclass type, got %R", struct_type);
+                return NULL;
+        }
+        if ((size_t)SD_BUS_PY_TUPLE_GET_SIZE(struct_fields) != plan->nodes[0].children_count) {
+                PyErr_Format(PyExc_TypeError, "Struct %R has %zu elements but %R has %zd fields", signature_str, plan->nodes[0].children_count,
+                             struct_type, SD_BUS_PY_TUPLE_GET_SIZE(struct_fields));
+                return NULL;
+        }
+
+        CALL_PYTHON_INT_CHECK(PyDict_SetItem(struct_types_dict, signature_str, struct_type));
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* is_interface_name_valid(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -204,7 +354,7 @@ static PyObject* is_interface_name_valid(PyObject* Py_UNUSED(self), PyObject* ar
 #endif
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* is_service_name_valid(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -227,7 +377,7 @@ static PyObject* is_service_name_valid(PyObject* Py_UNUSED(self), PyObject* args
 #endif
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* is_member_name_valid(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -250,7 +400,7 @@ static PyObject* is_member_name_valid(PyObject* Py_UNUSED(self), PyObject* args)
 #endif
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* is_object_path_valid(PyObject* Py_UNUSED(self), PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -286,6 +436,12 @@ PyMethodDef SdBusPyInternal_methods[] = {
     {"decode_object_path", (SD_BUS_PY_FUNC_TYPE)decode_object_path, SD_BUS_PY_METH, "Decode object path with object path prefix and arbitrary string"},
     {"map_exception_to_dbus_error", (SD_BUS_PY_FUNC_TYPE)map_exception_to_dbus_error, SD_BUS_PY_METH, "Map exception to a D-Bus error name"},
     {"add_exception_mapping", (SD_BUS_PY_FUNC_TYPE)add_exception_mapping, SD_BUS_PY_METH, "Add exception to the mapping of dbus error names"},
+    {"set_signature_decode_flags", (SD_BUS_PY_FUNC_TYPE)set_signature_decode_flags, SD_BUS_PY_METH, "Set default decode flags for messages with the signature"},
+    {"set_signature_encode_flags", (SD_BUS_PY_FUNC_TYPE)set_signature_encode_flags, SD_BUS_PY_METH, "Set encode flags for messages with the signature"},
+    {"set_variant_int_signature", (SD_BUS_PY_FUNC_TYPE)set_variant_int_signature, SD_BUS_PY_METH, "Set signature of ints in variants with inferred signature"},
+    {"set_string_cache_size", (SD_BUS_PY_FUNC_TYPE)set_string_cache_size, SD_BUS_PY_METH, "Set number of entries in the decoded strings cache"},
+    {"get_string_cache_stats", (PyCFunction)get_string_cache_stats, METH_NOARGS, "Get decoded strings cache statistics"},
+    {"register_struct_type", (SD_BUS_PY_FUNC_TYPE)register_struct_type, SD_BUS_PY_METH, "Decode structs of the signature as the NamedTuple or dataclass"},
     {"is_interface_name_valid", (SD_BUS_PY_FUNC_TYPE)is_interface_name_valid, SD_BUS_PY_METH, "Is the string valid interface name?"},
     {"is_service_name_valid", (SD_BUS_PY_FUNC_TYPE)is_service_name_valid, SD_BUS_PY_METH, "Is the string valid service name?"},
     {"is_member_name_valid", (SD_BUS_PY_FUNC_TYPE)is_member_name_valid, SD_BUS_PY_METH, "Is the string valid member name?"},
@@ -0,0 +1,356 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+    Copyright (C) 2020, 2021 igo95862
+
+    This file is part of python-sdbus
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+#include "sd_bus_internals.h"
+
+// SdBusFuture
+//
+// Replaces asyncio.Future for the asynchronous calls. Owns the sd-bus
+// slot of the pending call so no other objects need to be allocated per call.
+//
+// Implements the same protocol as asyncio.Future: tasks recognize it by
+// the _asyncio_future_blocking attribute and wait for it with add_done_callback.
+// This also makes it usable with gather, wait_for, shield and others.
+
+static void SdBusFuture_clear_fields(SdBusFutureObject* self) {
+        Py_CLEAR(self->loop);
+        Py_CLEAR(self->result);
+        Py_CLEAR(self->exception);
+        Py_CLEAR(self->cancel_message);
+        Py_CLEAR(self->callbacks);
+        Py_CLEAR(self->success_result);
+        Py_CLEAR(self->decode_flags);
+        Py_CLEAR(self->struct_types);
+}
+
+static int SdBusFuture_traverse(SdBusFutureObject* self, visitproc visit, void* arg) {
+        // Callbacks usually hold the task awaiting the future
+        Py_VISIT(self->loop);
+        Py_VISIT(self->result);
+        Py_VISIT(self->exception);
+        Py_VISIT(self->cancel_message);
+        Py_VISIT(self->callbacks);
+        Py_VISIT(self->success_result);
+        Py_VISIT(self->decode_flags);
+        Py_VISIT(self->struct_types);
+#if !defined(Py_LIMITED_API) && PY_VERSION_HEX >= 0x03090000
+        Py_VISIT(Py_TYPE(self));
+#endif
+        return 0;
+}
+
+static int SdBusFuture_clear(SdBusFutureObject* self) {
+        SdBusFuture_clear_fields(self);
+        return 0;
+}
+
+static void SdBusFuture_dealloc(SdBusFutureObject* self) {
+        PyObject_GC_UnTrack(self);
+        // Unreferencing the slot cancels the pending call
+        sd_bus_slot_unref(self->slot_ref);
+        SdBusFuture_clear_fields(self);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+SdBusFutureObject* _SdBusFuture_new(PyObject* loop) {
+        SdBusFutureObject* new_future = (SdBusFutureObject*)CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusFuture_class));
+        Py_INCREF(loop);
+        new_future->loop = loop;
+        return new_future;
+}
+
+static int _SdBusFuture_schedule_callback(SdBusFutureObject* self, PyObject* callback, PyObject* context) {
+        // loop.call_soon(callback, future, context=context)
+        PyObject* call_soon_method CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_GetAttr(self->loop, call_soon_str));
+        PyObject* new_handle CLEANUP_PY_OBJECT = NULL;
+        if (context == Py_None) {
+                new_handle = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_CallFunctionObjArgs(call_soon_method, callback, self, NULL));
+                return 0;
+        }
+#ifdef SD_BUS_PY_HAS_VECTORCALL
+        PyObject* call_args[3] = {callback, (PyObject*)self, context};
+        new_handle = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_Vectorcall(call_soon_method, call_args, 2, context_kwnames));
+#else
+        PyObject* call_args CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(Py_BuildValue("(OO)", callback, self));
+        PyObject* call_kwargs CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(Py_BuildValue("{s:O}", "context", context));
+        new_handle = CALL_PYTHON_CHECK_RETURN_NEG1(PyObject_Call(call_soon_method, call_args, call_kwargs));
+#endif
+        return 0;
+}
+
+static int _SdBusFuture_schedule_callbacks(SdBusFutureObject* self) {
+        PyObject* callbacks CLEANUP_PY_OBJECT = self->callbacks;
+        self->callbacks = NULL;
+        if (callbacks == NULL) {
+                return 0;
+        }
+        Py_ssize_t callbacks_count = SD_BUS_PY_LIST_GET_SIZE(callbacks);
+        for (Py_ssize_t i = 0; i < callbacks_count; ++i) {
+                PyObject* callback_tuple = SD_BUS_PY_LIST_GET_ITEM(callbacks, i);
+                if (_SdBusFuture_schedule_callback(self, SD_BUS_PY_TUPLE_GET_ITEM(callback_tuple, 0), SD_BUS_PY_TUPLE_GET_ITEM(callback_tuple, 1)) < 0) {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+int _SdBusFuture_set_result(SdBusFutureObject* self, PyObject* result) {
+        if (self->state != SD_BUS_PY_FUTURE_PENDING) {
+                return 0;
+        }
+        Py_INCREF(result);
+        self->result = result;
+        self->state = SD_BUS_PY_FUTURE_FINISHED;
+        return _SdBusFuture_schedule_callbacks(self);
+}
+
+int _SdBusFuture_set_exception(SdBusFutureObject* self, PyObject* exception) {
+        if (self->state != SD_BUS_PY_FUTURE_PENDING) {
+                return 0;
+        }
+        Py_INCREF(exception);
+        self->exception = exception;
+        self->state = SD_BUS_PY_FUTURE_FINISHED;
+        return _SdBusFuture_schedule_callbacks(self);
+}
+
+int _SdBusFuture_set_exception_from_error(SdBusFutureObject* self) {
+        PyObject* exception_type = NULL;
+        PyObject* exception_value = NULL;
+        PyObject* exception_traceback = NULL;
+        PyErr_Fetch(&exception_type, &exception_value, &exception_traceback);
+        PyErr_NormalizeException(&exception_type, &exception_value, &exception_traceback);
+        if (exception_traceback != NULL) {
+                PyException_SetTraceback(exception_value, exception_traceback);
+        }
+        int return_value = _SdBusFuture_set_exception(self, exception_value);
+        Py_XDECREF(exception_type);
+        Py_XDECREF(exception_value);
+        Py_XDECREF(exception_traceback);
+        return return_value;
+}
+
+static PyObject* SdBusFuture_make_cancelled_error(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        if (self->cancel_message == NULL) {
+                return PyObject_CallFunctionObjArgs(asyncio_cancelled_error, NULL);
+        }
+        return PyObject_CallFunctionObjArgs(asyncio_cancelled_error, self->cancel_message, NULL);
+}
+
+static int _SdBusFuture_raise_if_not_finished(SdBusFutureObject* self) {
+        if (self->state == SD_BUS_PY_FUTURE_CANCELLED) {
+                PyObject* cancelled_error CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(SdBusFuture_make_cancelled_error(self, NULL));
+                PyErr_SetObject(asyncio_cancelled_error, cancelled_error);
+                return -1;
+        }
+        if (self->state == SD_BUS_PY_FUTURE_PENDING) {
+                PyErr_SetString(asyncio_invalid_state_error, "Result is not ready.");
+                return -1;
+        }
+        return 0;
+}
+
+static PyObject* SdBusFuture_result(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        CALL_PYTHON_INT_CHECK(_SdBusFuture_raise_if_not_finished(self));
+        if (self->exception != NULL) {
+                PyErr_SetObject((PyObject*)Py_TYPE(self->exception), self->exception);
+                return NULL;
+        }
+        Py_INCREF(self->result);
+        return self->result;
+}
+
+static PyObject* SdBusFuture_exception(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        CALL_PYTHON_INT_CHECK(_SdBusFuture_raise_if_not_finished(self));
+        if (self->exception == NULL) {
+                Py_RETURN_NONE;
+        }
+        Py_INCREF(self->exception);
+        return self->exception;
+}
+
+static PyObject* SdBusFuture_done(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        return PyBool_FromLong(self->state != SD_BUS_PY_FUTURE_PENDING);
+}
+
+static PyObject* SdBusFuture_cancelled(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        return PyBool_FromLong(self->state == SD_BUS_PY_FUTURE_CANCELLED);
+}
+
+static PyObject* SdBusFuture_get_loop(SdBusFutureObject* self, PyObject* Py_UNUSED(args)) {
+        Py_INCREF(self->loop);
+        return self->loop;
+}
+
+static PyObject* SdBusFuture_cancel(SdBusFutureObject* self, PyObject* args, PyObject* kwargs) {
+        static char* kwlist[] = {"msg", NULL};
+        PyObject* cancel_message = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTupleAndKeywords(args, kwargs, "|O:cancel", kwlist, &cancel_message));
+
+        if (self->state != SD_BUS_PY_FUTURE_PENDING) {
+                Py_RETURN_FALSE;
+        }
+        if (cancel_message != NULL && cancel_message != Py_None) {
+                Py_INCREF(cancel_message);
+                self->cancel_message = cancel_message;
+        }
+        self->state = SD_BUS_PY_FUTURE_CANCELLED;
+        // Drop the pending call right away instead of waiting
+        // for the reply or timeout. sd-bus will discard the reply.
+        self->slot_ref = sd_bus_slot_unref(self->slot_ref);
+        CALL_PYTHON_INT_CHECK(_SdBusFuture_schedule_callbacks(self));
+        Py_RETURN_TRUE;
+}
+
+static PyObject* _SdBusFuture_add_done_callback(SdBusFutureObject* self, PyObject* callback, PyObject* context) {
+        if (self->state != SD_BUS_PY_FUTURE_PENDING) {
+                CALL_PYTHON_INT_CHECK(_SdBusFuture_schedule_callback(self, callback, context));
+                Py_RETURN_NONE;
+        }
+        if (self->callbacks == NULL) {
+                self->callbacks = CALL_PYTHON_AND_CHECK(PyList_New(0));
+        }
+        PyObject* callback_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyTuple_Pack(2, callback, context));
+        CALL_PYTHON_INT_CHECK(PyList_Append(self->callbacks, callback_tuple));
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusFuture_add_done_callback(SdBusFutureObject* self, PyObject* const* args, Py_ssize_t nargs, PyObject* kwnames) {
+        // Tasks pass their context as keyword argument
+        SD_BUS_PY_CHECK_ARGS_NUMBER(1);
+        PyObject* context = Py_None;
+        if (kwnames != NULL && SD_BUS_PY_TUPLE_GET_SIZE(kwnames) > 0) {
+                if (SD_BUS_PY_TUPLE_GET_SIZE(kwnames) != 1 || PyUnicode_CompareWithASCIIString(SD_BUS_PY_TUPLE_GET_ITEM(kwnames, 0), "context") != 0) {
+                        PyErr_SetString(PyExc_TypeError, "add_done_callback() only accepts context keyword argument");
+                        return NULL;
+                }
+                context = args[1];
+        }
+        return _SdBusFuture_add_done_callback(self, args[0], context);
+}
+#else
+static PyObject* SdBusFuture_add_done_callback(SdBusFutureObject* self, PyObject* args, PyObject* kwargs) {
+        static char* kwlist[] = {"", "context", NULL};
+        PyObject* callback = NULL;
+        PyObject* context = Py_None;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTupleAndKeywords(args, kwargs, "O|$O:add_done_callback", kwlist, &callback, &context));
+        return _SdBusFuture_add_done_callback(self, callback, context);
+}
+#endif
+
+static PyObject* SdBusFuture_remove_done_callback(SdBusFutureObject* self, PyObject* callback) {
+        if (self->callbacks == NULL) {
+                return PyLong_FromLong(0);
+        }
+        PyObject* kept_callbacks CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyList_New(0));
+        Py_ssize_t callbacks_count = SD_BUS_PY_LIST_GET_SIZE(self->callbacks);
+        for (Py_ssize_t i = 0; i < callbacks_count; ++i) {
+                PyObject* callback_tuple = SD_BUS_PY_LIST_GET_ITEM(self->callbacks, i);
+                int is_equal = CALL_PYTHON_INT_CHECK(PyObject_RichCompareBool(SD_BUS_PY_TUPLE_GET_ITEM(callback_tuple, 0), callback, Py_EQ));
+                if (!is_equal) {
+                        CALL_PYTHON_INT_CHECK(PyList_Append(kept_callbacks, callback_tuple));
+                }
+        }
+        Py_ssize_t removed_count = callbacks_count - SD_BUS_PY_LIST_GET_SIZE(kept_callbacks);
+        Py_DECREF(self->callbacks);
+        Py_INCREF(kept_callbacks);
+        self->callbacks = kept_callbacks;
+        return PyLong_FromSsize_t(removed_count);
+}
+
+static PyObject* SdBusFuture_iternext(SdBusFutureObject* self) {
+        // Iterator protocol of await:
+        // yield the future to the task until done and then return its result.
+        if (self->state == SD_BUS_PY_FUTURE_PENDING) {
+                self->blocking = 1;
+                Py_INCREF(self);
+                return (PyObject*)self;
+        }
+        PyObject* result CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(SdBusFuture_result(self, NULL));
+        // Exception instance is created explicitly so that
+        // tuple results are not unpacked as StopIteration arguments.
+        PyObject* stop_iteration CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(PyExc_StopIteration, result, NULL));
+        PyErr_SetObject(PyExc_StopIteration, stop_iteration);
+        return NULL;
+}
+
+static PyObject* SdBusFuture_await(SdBusFutureObject* self) {
+        Py_INCREF(self);
+        return (PyObject*)self;
+}
+
+static PyObject* SdBusFuture_blocking_getter(SdBusFutureObject* self, void* Py_UNUSED(closure)) {
+        return PyBool_FromLong(self->blocking);
+}
+
+static int SdBusFuture_blocking_setter(SdBusFutureObject* self, PyObject* new_value, void* Py_UNUSED(closure)) {
+        if (new_value == NULL) {
+                PyErr_SetString(PyExc_AttributeError, "Can't delete _asyncio_future_blocking");
+                return -1;
+        }
+        int is_blocking = PyObject_IsTrue(new_value);
+        if (is_blocking < 0) {
+                return -1;
+        }
+        self->blocking = is_blocking;
+        return 0;
+}
+
+static PyGetSetDef SdBusFuture_properties[] = {
+    {"_asyncio_future_blocking", (getter)SdBusFuture_blocking_getter, (setter)SdBusFuture_blocking_setter, "Used by asyncio tasks", NULL},
+    {"_loop", (getter)SdBusFuture_get_loop, NULL, "Event loop of the future", NULL},
+    {0},
+};
+
+static PyMethodDef SdBusFuture_methods[] = {
+    {"result", (PyCFunction)SdBusFuture_result, METH_NOARGS, "Return the result or raise the exception"},
+    {"exception", (PyCFunction)SdBusFuture_exception, METH_NOARGS, "Return the exception or None"},
+    {"done", (PyCFunction)SdBusFuture_done, METH_NOARGS, "Is result or exception set or future cancelled"},
+    {"cancelled", (PyCFunction)SdBusFuture_cancelled, METH_NOARGS, "Is future cancelled"},
+    {"get_loop", (PyCFunction)SdBusFuture_get_loop, METH_NOARGS, "Return the event loop of the future"},
+    {"cancel", (PyCFunction)(void (*)(void))SdBusFuture_cancel, METH_VARARGS | METH_KEYWORDS, "Cancel the future"},
+    {"add_done_callback", (PyCFunction)(void (*)(void))SdBusFuture_add_done_callback, SD_BUS_PY_METH | METH_KEYWORDS,
+     "Schedule the callback to be called when future is done"},
+    {"remove_done_callback", (PyCFunction)SdBusFuture_remove_done_callback, METH_O, "Remove the callback"},
+    {"_make_cancelled_error", (PyCFunction)SdBusFuture_make_cancelled_error, METH_NOARGS, "Create CancelledError of the cancelled future"},
+    {NULL, NULL, 0, NULL},
+};
+
+PyType_Spec SdBusFutureType = {
+    .name = "sd_bus_internals.SdBusFuture",
+    .basicsize = sizeof(SdBusFutureObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusFuture_dealloc},
+            {Py_tp_traverse, (traverseproc)SdBusFuture_traverse},
+            {Py_tp_clear, (inquiry)SdBusFuture_clear},
+            {Py_tp_methods, SdBusFuture_methods},
+            {Py_tp_getset, SdBusFuture_properties},
+            {Py_tp_iter, SdBusFuture_await},
+            {Py_tp_iternext, (iternextfunc)SdBusFuture_iternext},
+            {Py_am_await, (unaryfunc)SdBusFuture_await},
+            {0, NULL},
+        },
+};
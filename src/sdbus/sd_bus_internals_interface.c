@@ -42,6 +42,7 @@ static void SdBusInterface_dealloc(SdBusInterfaceObject* self) {
         Py_XDECREF(self->property_get_dict);
         Py_XDECREF(self->property_set_dict);
         Py_XDECREF(self->signal_list);
+        Py_XDECREF(self->attached_bus);
         if (self->vtable) {
                 free(self->vtable);
         }
@@ -53,7 +54,7 @@ static inline int _check_callable_or_none(PyObject* some_object) {
         return PyCallable_Check(some_object) || (Py_None == some_object);
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusInterface_add_property(SdBusInterfaceObject* self, PyObject* const* args, Py_ssize_t nargs) {
         // Arguments
         // Name, Signature, Get, Set, Flags
@@ -90,7 +91,7 @@ static PyObject* SdBusInterface_add_property(SdBusInterfaceObject* self, PyObjec
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusInterface_add_method(SdBusInterfaceObject* self, PyObject* const* args, Py_ssize_t nargs) {
         // Arguments
         // Method name, signature, names of input values, result signature,
@@ -148,7 +149,7 @@ static PyObject* SdBusInterface_add_method(SdBusInterfaceObject* self, PyObject*
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusInterface_add_signal(SdBusInterfaceObject* self, PyObject* const* args, Py_ssize_t nargs) {
         // Arguments
         // Signal name, signature, names of input values, flags
@@ -320,11 +321,23 @@ static PyObject* SdBusInterface_create_vtable(SdBusInterfaceObject* self, PyObje
         Py_RETURN_NONE;
 }
 
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusInterface_set_decode_limits(SdBusInterfaceObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args, nargs));
+#else
+static PyObject* SdBusInterface_set_decode_limits(SdBusInterfaceObject* self, PyObject* args) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args));
+#endif
+        Py_RETURN_NONE;
+}
+
 static PyMethodDef SdBusInterface_methods[] = {
     {"add_method", (SD_BUS_PY_FUNC_TYPE)SdBusInterface_add_method, SD_BUS_PY_METH, "Add method to the dbus interface"},
     {"add_property", (SD_BUS_PY_FUNC_TYPE)SdBusInterface_add_property, SD_BUS_PY_METH, "Add property to the dbus interface"},
     {"add_signal", (SD_BUS_PY_FUNC_TYPE)SdBusInterface_add_signal, SD_BUS_PY_METH, "Add signal to the dbus interface"},
     {"_create_vtable", (PyCFunction)SdBusInterface_create_vtable, METH_NOARGS, "Creates the vtable"},
+    {"set_decode_limits", (SD_BUS_PY_FUNC_TYPE)SdBusInterface_set_decode_limits, SD_BUS_PY_METH,
+     "Set limits of decoding method calls and property sets. Overrides limits of the bus."},
     {NULL, NULL, 0, NULL},
 };
 
@@ -353,7 +366,7 @@ PyType_Spec SdBusInterfaceType = {
 };
 
 static int set_dbus_error_from_python_exception(sd_bus_error* ret_error) {
-#ifdef Py_LIMITED_API
+#ifndef SD_BUS_PY_HAS_UNICODE_AS_UTF8
         PyObject* dbus_error_bytes CLEANUP_PY_OBJECT = NULL;
 #endif
         PyObject* current_exception = PyErr_Occurred();
@@ -361,7 +374,7 @@ static int set_dbus_error_from_python_exception(sd_bus_error* ret_error) {
                 goto fail;
         }
         PyObject* dbus_error_str = CALL_PYTHON_GOTO_FAIL(PyDict_GetItem(exception_to_dbus_error_dict, current_exception));
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
         const char* dbus_error_char_ptr = SD_BUS_PY_UNICODE_AS_CHAR_PTR_GOTO_FAIL(dbus_error_str);
 #else
         dbus_error_bytes = SD_BUS_PY_UNICODE_AS_BYTES_GOTO_FAIL(dbus_error_str);
@@ -374,6 +387,26 @@ fail:
 
 #define METHOD_CALLBACK_ERROR_CHECK(py_function) CALL_PYTHON_FAIL_ACTION(py_function, return set_dbus_error_from_python_exception(ret_error))
 
+static void _SdBusInterface_set_message_limits(SdBusInterfaceObject* self, PyObject* message_object) {
+        // Messages from peers are decoded with the interface limits or the bus limits
+        SdBusMessageObject* message = (SdBusMessageObject*)message_object;
+        if (_SdBusDecodeLimits_or_null(&self->decode_limits) != NULL) {
+                message->decode_limits = self->decode_limits;
+        } else if (self->attached_bus != NULL) {
+                message->decode_limits = ((SdBusObject*)self->attached_bus)->decode_limits;
+        }
+}
+
+static PyObject* _SdBusInterface_get_loop(SdBusInterfaceObject* self) {
+        // Loop of the bus the interface was added to
+        if (self->attached_bus != NULL && ((SdBusObject*)self->attached_bus)->loop != NULL) {
+                PyObject* bus_loop = ((SdBusObject*)self->attached_bus)->loop;
+                Py_INCREF(bus_loop);
+                return bus_loop;
+        }
+        return PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL);
+}
+
 static int _SdBusInterface_callback(sd_bus_message* m, void* userdata, sd_bus_error* ret_error) {
         // TODO: Better error handling
         SdBusInterfaceObject* self = userdata;
@@ -382,11 +415,10 @@ static int _SdBusInterface_callback(sd_bus_message* m, void* userdata, sd_bus_er
         PyObject* member_name_bytes CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(PyBytes_FromString(member_char_ptr));
         PyObject* callback_object = METHOD_CALLBACK_ERROR_CHECK(PyDict_GetItem(self->method_dict, member_name_bytes));
 
-        PyObject* running_loop CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(PyObject_CallFunctionObjArgs(asyncio_get_running_loop, NULL));
-
         PyObject* new_message CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessage_class));
 
         _SdBusMessage_set_messsage((SdBusMessageObject*)new_message, m);
+        _SdBusInterface_set_message_limits(self, new_message);
 
         PyObject* is_coroutine_test_object CLEANUP_PY_OBJECT =
             METHOD_CALLBACK_ERROR_CHECK(PyObject_CallFunctionObjArgs(is_coroutine_function, callback_object, NULL));
@@ -394,6 +426,7 @@ static int _SdBusInterface_callback(sd_bus_message* m, void* userdata, sd_bus_er
         if (Py_True == is_coroutine_test_object) {
                 // Create coroutine
                 PyObject* coroutine_activated CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(PyObject_CallFunctionObjArgs(callback_object, new_message, NULL));
+                PyObject* running_loop CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(_SdBusInterface_get_loop(self));
 
                 Py_XDECREF(METHOD_CALLBACK_ERROR_CHECK(PyObject_CallMethodObjArgs(running_loop, create_task_str, coroutine_activated, NULL)));
         } else {
@@ -441,6 +474,7 @@ static int _SdBusInterface_property_set_callback(sd_bus* Py_UNUSED(bus),
 
         PyObject* new_message CLEANUP_PY_OBJECT = METHOD_CALLBACK_ERROR_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessage_class));
         _SdBusMessage_set_messsage((SdBusMessageObject*)new_message, value);
+        _SdBusInterface_set_message_limits(self, new_message);
 
         Py_XDECREF(METHOD_CALLBACK_ERROR_CHECK(PyObject_CallFunctionObjArgs(set_call, new_message, NULL)));
         return 0;
@@ -0,0 +1,955 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+    Copyright (C) 2020, 2021 igo95862
+
+    This file is part of python-sdbus
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+#include "sd_bus_internals.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+
+// JSON
+//
+// Message body is written to and read from compact JSON text directly
+// without creating the Python objects of the values.
+//
+//      y n q i u x t h         number
+//      b                       true or false
+//      d                       number, null for NaN and infinities
+//      s o g                   string
+//      ay                      base64 string
+//      arrays and structs      array
+//      dicts                   object, keys of other types than string
+//                              are written as strings: {"1": "a"}
+//      v                       [signature, value] array
+//
+// Body of a single complete type is the value itself, multiple
+// complete types are an array and an empty body is null.
+// Apart from the byte arrays this matches json.dumps of get_contents result.
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Writer
+
+typedef struct {
+        char* data;
+        size_t length;
+        size_t allocated;
+} _Json_writer;
+
+static void _cleanup_json_writer(_Json_writer* writer) {
+        PyMem_Free(writer->data);
+}
+
+static int _json_reserve(_Json_writer* writer, size_t additional_length) {
+        if (writer->length + additional_length <= writer->allocated) {
+                return 0;
+        }
+        size_t new_allocated = writer->allocated == 0 ? 256 : writer->allocated;
+        while (new_allocated < writer->length + additional_length) {
+                new_allocated *= 2;
+        }
+        char* new_data = PyMem_Realloc(writer->data, new_allocated);
+        if (new_data == NULL) {
+                PyErr_NoMemory();
+                return -1;
+        }
+        writer->data = new_data;
+        writer->allocated = new_allocated;
+        return 0;
+}
+
+static int _json_write(_Json_writer* writer, const char* text, size_t text_length) {
+        if (_json_reserve(writer, text_length) < 0) {
+                return -1;
+        }
+        memcpy(writer->data + writer->length, text, text_length);
+        writer->length += text_length;
+        return 0;
+}
+
+static int _json_write_char(_Json_writer* writer, char new_char) {
+        return _json_write(writer, &new_char, 1);
+}
+
+static int _json_write_string(_Json_writer* writer, const char* utf8) {
+        // D-Bus strings are valid UTF-8 and only need the JSON escapes
+        if (_json_write_char(writer, '"') < 0) {
+                return -1;
+        }
+        const char* chunk_start = utf8;
+        for (const char* current = utf8; *current != '\0'; ++current) {
+                unsigned char current_char = (unsigned char)*current;
+                if (current_char >= 0x20 && current_char != '"' && current_char != '\\') {
+                        continue;
+                }
+                if (_json_write(writer, chunk_start, (size_t)(current - chunk_start)) < 0) {
+                        return -1;
+                }
+                chunk_start = current + 1;
+
+                char escape[8] = {'\\', '\0'};
+                size_t escape_length = 2;
+                switch (current_char) {
+                        case '"':
+                        case '\\':
+                                escape[1] = (char)current_char;
+                                break;
+                        case '\n':
+                                escape[1] = 'n';
+                                break;
+                        case '\r':
+                                escape[1] = 'r';
+                                break;
+                        case '\t':
+                                escape[1] = 't';
+                                break;
+                        case '\b':
+                                escape[1] = 'b';
+                                break;
+                        case '\f':
+                                escape[1] = 'f';
+                                break;
+                        default:
+                                escape_length = (size_t)snprintf(escape, sizeof(escape), "\\u%04x", current_char);
+                                break;
+                }
+                if (_json_write(writer, escape, escape_length) < 0) {
+                        return -1;
+                }
+        }
+        if (_json_write(writer, chunk_start, strlen(chunk_start)) < 0) {
+                return -1;
+        }
+        return _json_write_char(writer, '"');
+}
+
+static int _json_write_base64(_Json_writer* writer, const uint8_t* bytes, size_t bytes_length) {
+        size_t encoded_length = ((bytes_length + 2) / 3) * 4;
+        if (_json_reserve(writer, encoded_length + 2) < 0) {
+                return -1;
+        }
+        char* output = writer->data + writer->length;
+        *output++ = '"';
+        size_t i = 0;
+        for (; i + 2 < bytes_length; i += 3) {
+                uint32_t triple = ((uint32_t)bytes[i] << 16) | ((uint32_t)bytes[i + 1] << 8) | bytes[i + 2];
+                *output++ = base64_alphabet[(triple >> 18) & 0x3f];
+                *output++ = base64_alphabet[(triple >> 12) & 0x3f];
+                *output++ = base64_alphabet[(triple >> 6) & 0x3f];
+                *output++ = base64_alphabet[triple & 0x3f];
+        }
+        if (i < bytes_length) {
+                uint32_t triple = (uint32_t)bytes[i] << 16;
+                if (i + 1 < bytes_length) {
+                        triple |= (uint32_t)bytes[i + 1] << 8;
+                }
+                *output++ = base64_alphabet[(triple >> 18) & 0x3f];
+                *output++ = base64_alphabet[(triple >> 12) & 0x3f];
+                *output++ = i + 1 < bytes_length ? base64_alphabet[(triple >> 6) & 0x3f] : '=';
+                *output++ = '=';
+        }
+        *output++ = '"';
+        writer->length = (size_t)(output - writer->data);
+        return 0;
+}
+
+static int _json_write_double(_Json_writer* writer, double value) {
+        if (!isfinite(value)) {
+                return _json_write(writer, "null", 4);
+        }
+        // Same shortest representation as repr() and json.dumps
+        char* double_str = PyOS_double_to_string(value, 'r', 0, Py_DTSF_ADD_DOT_0, NULL);
+        if (double_str == NULL) {
+                return -1;
+        }
+        int return_value = _json_write(writer, double_str, strlen(double_str));
+        PyMem_Free(double_str);
+        return return_value;
+}
+
+static int _json_write_basic(_Json_writer* writer, sd_bus_message* message, char basic_type, int is_key) {
+        char number_str[32] = {0};
+        int number_length = 0;
+        switch (basic_type) {
+                case 's':
+                case 'o':
+                case 'g': {
+                        const char* new_string = NULL;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_string));
+                        return _json_write_string(writer, new_string);
+                }
+                case 'b': {
+                        int new_bool = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_bool));
+                        number_length = snprintf(number_str, sizeof(number_str), "%s", new_bool ? "true" : "false");
+                        break;
+                }
+                case 'y': {
+                        uint8_t new_byte = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_byte));
+                        number_length = snprintf(number_str, sizeof(number_str), "%u", (unsigned)new_byte);
+                        break;
+                }
+                case 'n': {
+                        int16_t new_short = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_short));
+                        number_length = snprintf(number_str, sizeof(number_str), "%d", (int)new_short);
+                        break;
+                }
+                case 'q': {
+                        uint16_t new_u_short = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_u_short));
+                        number_length = snprintf(number_str, sizeof(number_str), "%u", (unsigned)new_u_short);
+                        break;
+                }
+                case 'i':
+                case 'h': {
+                        int32_t new_int = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_int));
+                        number_length = snprintf(number_str, sizeof(number_str), "%ld", (long)new_int);
+                        break;
+                }
+                case 'u': {
+                        uint32_t new_u_int = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_u_int));
+                        number_length = snprintf(number_str, sizeof(number_str), "%lu", (unsigned long)new_u_int);
+                        break;
+                }
+                case 'x': {
+                        int64_t new_long_long = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_long_long));
+                        number_length = snprintf(number_str, sizeof(number_str), "%lld", (long long)new_long_long);
+                        break;
+                }
+                case 't': {
+                        uint64_t new_u_long_long = 0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_u_long_long));
+                        number_length = snprintf(number_str, sizeof(number_str), "%llu", (unsigned long long)new_u_long_long);
+                        break;
+                }
+                case 'd': {
+                        double new_double = 0.0;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, basic_type, &new_double));
+                        if (!is_key) {
+                                return _json_write_double(writer, new_double);
+                        }
+                        if (_json_write_char(writer, '"') < 0 || _json_write_double(writer, new_double) < 0) {
+                                return -1;
+                        }
+                        return _json_write_char(writer, '"');
+                }
+                default: {
+                        PyErr_Format(PyExc_TypeError, "Dbus type %c is unknown", (int)basic_type);
+                        return -1;
+                }
+        }
+        if (!is_key) {
+                return _json_write(writer, number_str, (size_t)number_length);
+        }
+        // Object keys can only be strings
+        if (_json_write_char(writer, '"') < 0 || _json_write(writer, number_str, (size_t)number_length) < 0) {
+                return -1;
+        }
+        return _json_write_char(writer, '"');
+}
+
+static int _json_write_complete(_Json_writer* writer, sd_bus_message* message, const SdBusSignatureNode* node);
+
+static int _json_write_array(_Json_writer* writer, sd_bus_message* message, const SdBusSignatureNode* node) {
+        const SdBusSignatureNode* element_node = node + 1;
+        if (element_node->type == 'y') {
+                const void* char_array = NULL;
+                size_t array_size = 0;
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_array(message, 'y', &char_array, &array_size));
+                return _json_write_base64(writer, char_array, array_size);
+        }
+
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_enter_container(message, 'a', node->contents));
+        int is_dict = element_node->type == 'e';
+        if (_json_write_char(writer, is_dict ? '{' : '[') < 0) {
+                return -1;
+        }
+        for (size_t i = 0; CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_at_end(message, 0)) == 0; ++i) {
+                if (i > 0 && _json_write_char(writer, ',') < 0) {
+                        return -1;
+                }
+                if (!is_dict) {
+                        if (_json_write_complete(writer, message, element_node) < 0) {
+                                return -1;
+                        }
+                        continue;
+                }
+                const SdBusSignatureNode* key_node = element_node + 1;
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_enter_container(message, 'e', element_node->contents));
+                if (_json_write_basic(writer, message, key_node->type, 1) < 0 || _json_write_char(writer, ':') < 0 ||
+                    _json_write_complete(writer, message, key_node + 1) < 0) {
+                        return -1;
+                }
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_exit_container(message));
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_exit_container(message));
+        return _json_write_char(writer, is_dict ? '}' : ']');
+}
+
+static int _json_write_fields(_Json_writer* writer, sd_bus_message* message, const SdBusSignatureNode* first_field_node, size_t fields_count) {
+        if (_json_write_char(writer, '[') < 0) {
+                return -1;
+        }
+        const SdBusSignatureNode* field_node = first_field_node;
+        for (size_t i = 0; i < fields_count; ++i) {
+                if (i > 0 && _json_write_char(writer, ',') < 0) {
+                        return -1;
+                }
+                if (_json_write_complete(writer, message, field_node) < 0) {
+                        return -1;
+                }
+                field_node += field_node->subtree_size;
+        }
+        return _json_write_char(writer, ']');
+}
+
+static int _json_write_variant(_Json_writer* writer, sd_bus_message* message) {
+        const char* container_signature = NULL;
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_peek_type(message, NULL, &container_signature));
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_enter_container(message, 'v', container_signature));
+        PyObject* variant_sig_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusStringCache_get(container_signature));
+        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusSignaturePlan_get(variant_sig_str));
+        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+
+        if (_json_write_char(writer, '[') < 0 || _json_write_string(writer, container_signature) < 0 || _json_write_char(writer, ',') < 0 ||
+            _json_write_complete(writer, message, &variant_plan->nodes[0]) < 0) {
+                return -1;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_exit_container(message));
+        return _json_write_char(writer, ']');
+}
+
+static int _json_write_complete(_Json_writer* writer, sd_bus_message* message, const SdBusSignatureNode* node) {
+        switch (node->type) {
+                case 'a': {
+                        return _json_write_array(writer, message, node);
+                }
+                case 'r': {
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_enter_container(message, 'r', node->contents));
+                        if (_json_write_fields(writer, message, node + 1, node->children_count) < 0) {
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_exit_container(message));
+                        return 0;
+                }
+                case 'v': {
+                        return _json_write_variant(writer, message);
+                }
+                default: {
+                        return _json_write_basic(writer, message, node->type, 0);
+                }
+        }
+}
+
+PyObject* _SdBusJson_dump_message(sd_bus_message* message, const SdBusSignaturePlan* plan) {
+        _Json_writer writer __attribute__((cleanup(_cleanup_json_writer))) = {0};
+        if (plan->top_level_count == 0) {
+                CALL_PYTHON_INT_CHECK(_json_write(&writer, "null", 4));
+        } else if (plan->top_level_count == 1) {
+                CALL_PYTHON_INT_CHECK(_json_write_complete(&writer, message, plan->nodes));
+        } else {
+                CALL_PYTHON_INT_CHECK(_json_write_fields(&writer, message, plan->nodes, plan->top_level_count));
+        }
+        return PyBytes_FromStringAndSize(writer.data, (Py_ssize_t)writer.length);
+}
+
+// Reader
+
+typedef struct {
+        const char* data;
+        size_t length;
+        size_t index;
+        // Scratch buffer of the last read string or base64 bytes
+        char* buffer;
+        size_t buffer_allocated;
+} _Json_reader;
+
+static void _cleanup_json_reader(_Json_reader* reader) {
+        PyMem_Free(reader->buffer);
+}
+
+static int _json_syntax_error(_Json_reader* reader, const char* expected) {
+        PyErr_Format(PyExc_ValueError, "Invalid JSON at position %zu: expected %s", reader->index, expected);
+        return -1;
+}
+
+static char _json_peek(_Json_reader* reader) {
+        // Skips whitespace and returns the next char or '\0' at the end
+        while (reader->index < reader->length) {
+                char current_char = reader->data[reader->index];
+                if (current_char != ' ' && current_char != '\t' && current_char != '\n' && current_char != '\r') {
+                        return current_char;
+                }
+                reader->index++;
+        }
+        return '\0';
+}
+
+static int _json_expect(_Json_reader* reader, char expected_char) {
+        if (_json_peek(reader) != expected_char) {
+                char expected[4] = {'\'', expected_char, '\'', '\0'};
+                return _json_syntax_error(reader, expected);
+        }
+        reader->index++;
+        return 0;
+}
+
+static int _json_expect_literal(_Json_reader* reader, const char* literal) {
+        size_t literal_length = strlen(literal);
+        _json_peek(reader);
+        if (reader->length - reader->index < literal_length || memcmp(reader->data + reader->index, literal, literal_length) != 0) {
+                return _json_syntax_error(reader, literal);
+        }
+        reader->index += literal_length;
+        return 0;
+}
+
+static int _json_buffer_reserve(_Json_reader* reader, size_t new_size) {
+        if (new_size <= reader->buffer_allocated) {
+                return 0;
+        }
+        char* new_buffer = PyMem_Realloc(reader->buffer, new_size);
+        if (new_buffer == NULL) {
+                PyErr_NoMemory();
+                return -1;
+        }
+        reader->buffer = new_buffer;
+        reader->buffer_allocated = new_size;
+        return 0;
+}
+
+static int _json_read_hex4(_Json_reader* reader, uint32_t* code_point) {
+        if (reader->length - reader->index < 4) {
+                return _json_syntax_error(reader, "4 hex digits");
+        }
+        *code_point = 0;
+        for (size_t i = 0; i < 4; ++i) {
+                char hex_char = reader->data[reader->index++];
+                uint32_t digit = 0;
+                if (hex_char >= '0' && hex_char <= '9') {
+                        digit = (uint32_t)(hex_char - '0');
+                } else if (hex_char >= 'a' && hex_char <= 'f') {
+                        digit = (uint32_t)(hex_char - 'a' + 10);
+                } else if (hex_char >= 'A' && hex_char <= 'F') {
+                        digit = (uint32_t)(hex_char - 'A' + 10);
+                } else {
+                        return _json_syntax_error(reader, "hex digit");
+                }
+                *code_point = (*code_point << 4) | digit;
+        }
+        return 0;
+}
+
+static size_t _json_encode_utf8(uint32_t code_point, char* output) {
+        if (code_point < 0x80) {
+                output[0] = (char)code_point;
+                return 1;
+        }
+        if (code_point < 0x800) {
+                output[0] = (char)(0xc0 | (code_point >> 6));
+                output[1] = (char)(0x80 | (code_point & 0x3f));
+                return 2;
+        }
+        if (code_point < 0x10000) {
+                output[0] = (char)(0xe0 | (code_point >> 12));
+                output[1] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+                output[2] = (char)(0x80 | (code_point & 0x3f));
+                return 3;
+        }
+        output[0] = (char)(0xf0 | (code_point >> 18));
+        output[1] = (char)(0x80 | ((code_point >> 12) & 0x3f));
+        output[2] = (char)(0x80 | ((code_point >> 6) & 0x3f));
+        output[3] = (char)(0x80 | (code_point & 0x3f));
+        return 4;
+}
+
+static int _json_read_string(_Json_reader* reader, size_t* string_length) {
+        // Decodes the string in to the NUL terminated scratch buffer.
+        // Escapes only make the text shorter so the raw length is enough.
+        if (_json_expect(reader, '"') < 0) {
+                return -1;
+        }
+        const char* string_start = reader->data + reader->index;
+        const char* string_end = memchr(string_start, '"', reader->length - reader->index);
+        if (string_end == NULL) {
+                return _json_syntax_error(reader, "end of string");
+        }
+        size_t output_length = 0;
+        if (_json_buffer_reserve(reader, (size_t)(string_end - string_start) + 1) < 0) {
+                return -1;
+        }
+        while (1) {
+                if (reader->index >= reader->length) {
+                        return _json_syntax_error(reader, "end of string");
+                }
+                char current_char = reader->data[reader->index++];
+                if (current_char == '"') {
+                        break;
+                }
+                if ((unsigned char)current_char < 0x20) {
+                        reader->index--;
+                        return _json_syntax_error(reader, "escaped control character");
+                }
+                if (current_char != '\\') {
+                        if (_json_buffer_reserve(reader, output_length + 2) < 0) {
+                                return -1;
+                        }
+                        reader->buffer[output_length++] = current_char;
+                        continue;
+                }
+                if (reader->index >= reader->length) {
+                        return _json_syntax_error(reader, "escape sequence");
+                }
+                char escape_char = reader->data[reader->index++];
+                uint32_t code_point = 0;
+                switch (escape_char) {
+                        case '"':
+                        case '\\':
+                        case '/':
+                                code_point = (uint32_t)escape_char;
+                                break;
+                        case 'b':
+                                code_point = '\b';
+                                break;
+                        case 'f':
+                                code_point = '\f';
+                                break;
+                        case 'n':
+                                code_point = '\n';
+                                break;
+                        case 'r':
+                                code_point = '\r';
+                                break;
+                        case 't':
+                                code_point = '\t';
+                                break;
+                        case 'u': {
+                                if (_json_read_hex4(reader, &code_point) < 0) {
+                                        return -1;
+                                }
+                                if (code_point >= 0xd800 && code_point < 0xdc00) {
+                                        uint32_t low_surrogate = 0;
+                                        if (reader->length - reader->index < 2 || reader->data[reader->index] != '\\' ||
+                                            reader->data[reader->index + 1] != 'u') {
+                                                return _json_syntax_error(reader, "low surrogate");
+                                        }
+                                        reader->index += 2;
+                                        if (_json_read_hex4(reader, &low_surrogate) < 0) {
+                                                return -1;
+                                        }
+                                        if (low_surrogate < 0xdc00 || low_surrogate >= 0xe000) {
+                                                return _json_syntax_error(reader, "low surrogate");
+                                        }
+                                        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low_surrogate - 0xdc00);
+                                } else if (code_point >= 0xdc00 && code_point < 0xe000) {
+                                        return _json_syntax_error(reader, "high surrogate");
+                                }
+                                break;
+                        }
+                        default:
+                                return _json_syntax_error(reader, "escape sequence");
+                }
+                if (code_point == 0) {
+                        PyErr_SetString(PyExc_ValueError, "D-Bus strings can't contain NUL characters");
+                        return -1;
+                }
+                if (_json_buffer_reserve(reader, output_length + 5) < 0) {
+                        return -1;
+                }
+                output_length += _json_encode_utf8(code_point, reader->buffer + output_length);
+        }
+        reader->buffer[output_length] = '\0';
+        *string_length = output_length;
+        return 0;
+}
+
+static int _base64_value(char base64_char) {
+        const char* found = base64_char != '\0' ? strchr(base64_alphabet, base64_char) : NULL;
+        return found != NULL ? (int)(found - base64_alphabet) : -1;
+}
+
+static int _json_read_base64(_Json_reader* reader, size_t* bytes_length) {
+        // Decodes in place in the scratch buffer
+        size_t encoded_length = 0;
+        if (_json_read_string(reader, &encoded_length) < 0) {
+                return -1;
+        }
+        if (encoded_length % 4 != 0) {
+                PyErr_SetString(PyExc_ValueError, "Invalid base64 length of byte array");
+                return -1;
+        }
+        uint8_t* output = (uint8_t*)reader->buffer;
+        size_t output_length = 0;
+        for (size_t i = 0; i < encoded_length; i += 4) {
+                const char* quad = reader->buffer + i;
+                int is_last = i + 4 == encoded_length;
+                int values[4] = {0};
+                size_t padding = 0;
+                for (size_t j = 0; j < 4; ++j) {
+                        if (is_last && j >= 2 && quad[j] == '=' && (j == 3 || quad[3] == '=')) {
+                                padding++;
+                                continue;
+                        }
+                        values[j] = _base64_value(quad[j]);
+                        if (values[j] < 0) {
+                                PyErr_SetString(PyExc_ValueError, "Invalid base64 character in byte array");
+                                return -1;
+                        }
+                }
+                uint32_t triple = ((uint32_t)values[0] << 18) | ((uint32_t)values[1] << 12) | ((uint32_t)values[2] << 6) | (uint32_t)values[3];
+                output[output_length++] = (uint8_t)(triple >> 16);
+                if (padding < 2) {
+                        output[output_length++] = (uint8_t)(triple >> 8);
+                }
+                if (padding < 1) {
+                        output[output_length++] = (uint8_t)triple;
+                }
+        }
+        *bytes_length = output_length;
+        return 0;
+}
+
+static int _json_read_number(_Json_reader* reader, char* number_str, size_t number_str_size) {
+        _json_peek(reader);
+        size_t number_length = 0;
+        while (reader->index < reader->length) {
+                char current_char = reader->data[reader->index];
+                if (!((current_char >= '0' && current_char <= '9') || current_char == '-' || current_char == '+' || current_char == '.' ||
+                      current_char == 'e' || current_char == 'E')) {
+                        break;
+                }
+                if (number_length + 1 >= number_str_size) {
+                        return _json_syntax_error(reader, "shorter number");
+                }
+                number_str[number_length++] = current_char;
+                reader->index++;
+        }
+        if (number_length == 0) {
+                return _json_syntax_error(reader, "number");
+        }
+        number_str[number_length] = '\0';
+        return 0;
+}
+
+static int _json_append_basic_from_text(sd_bus_message* message, char basic_type, const char* text) {
+        // Numbers and booleans are also parsed from the dict keys
+        char* text_end = NULL;
+        errno = 0;
+        switch (basic_type) {
+                case 'b': {
+                        int new_bool = 0;
+                        if (strcmp(text, "true") == 0) {
+                                new_bool = 1;
+                        } else if (strcmp(text, "false") != 0) {
+                                PyErr_Format(PyExc_ValueError, "Expected true or false, got %s", text);
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_bool));
+                        return 0;
+                }
+                case 'd': {
+                        double new_double = strtod(text, &text_end);
+                        if (text_end == text || *text_end != '\0') {
+                                PyErr_Format(PyExc_ValueError, "Expected number, got %s", text);
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_double));
+                        return 0;
+                }
+                case 't': {
+                        if (text[0] == '-') {
+                                PyErr_Format(PyExc_OverflowError, "Value %s is out of range of D-Bus type t", text);
+                                return -1;
+                        }
+                        unsigned long long new_u_long_long = strtoull(text, &text_end, 10);
+                        if (text_end == text || *text_end != '\0') {
+                                PyErr_Format(PyExc_ValueError, "Expected integer, got %s", text);
+                                return -1;
+                        }
+                        if (errno == ERANGE) {
+                                PyErr_Format(PyExc_OverflowError, "Value %s is out of range of D-Bus type t", text);
+                                return -1;
+                        }
+                        uint64_t new_u_int64 = (uint64_t)new_u_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_u_int64));
+                        return 0;
+                }
+                default: {
+                        break;
+                }
+        }
+
+        long long new_long_long = strtoll(text, &text_end, 10);
+        if (text_end == text || *text_end != '\0') {
+                PyErr_Format(PyExc_ValueError, "Expected integer, got %s", text);
+                return -1;
+        }
+        long long min_value = 0;
+        long long max_value = 0;
+        switch (basic_type) {
+                case 'y':
+                        max_value = UINT8_MAX;
+                        break;
+                case 'n':
+                        min_value = INT16_MIN;
+                        max_value = INT16_MAX;
+                        break;
+                case 'q':
+                        max_value = UINT16_MAX;
+                        break;
+                case 'i':
+                case 'h':
+                        min_value = INT32_MIN;
+                        max_value = INT32_MAX;
+                        break;
+                case 'u':
+                        max_value = UINT32_MAX;
+                        break;
+                case 'x':
+                        min_value = INT64_MIN;
+                        max_value = INT64_MAX;
+                        break;
+                default:
+                        PyErr_Format(PyExc_TypeError, "Dbus type %c is unknown", (int)basic_type);
+                        return -1;
+        }
+        if (errno == ERANGE || new_long_long < min_value || new_long_long > max_value) {
+                PyErr_Format(PyExc_OverflowError, "Value %s is out of range of D-Bus type %c", text, (int)basic_type);
+                return -1;
+        }
+        switch (basic_type) {
+                case 'y': {
+                        uint8_t new_byte = (uint8_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_byte));
+                        break;
+                }
+                case 'n': {
+                        int16_t new_short = (int16_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_short));
+                        break;
+                }
+                case 'q': {
+                        uint16_t new_u_short = (uint16_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_u_short));
+                        break;
+                }
+                case 'i':
+                case 'h': {
+                        int32_t new_int = (int32_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_int));
+                        break;
+                }
+                case 'u': {
+                        uint32_t new_u_int = (uint32_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_u_int));
+                        break;
+                }
+                default: {
+                        int64_t new_int64 = (int64_t)new_long_long;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, basic_type, &new_int64));
+                        break;
+                }
+        }
+        return 0;
+}
+
+static int _json_is_string_type(char type_char) {
+        return type_char == 's' || type_char == 'o' || type_char == 'g';
+}
+
+static int _json_append_complete(_Json_reader* reader, sd_bus_message* message, const SdBusSignatureNode* node);
+
+static int _json_append_key(_Json_reader* reader, sd_bus_message* message, char key_type) {
+        size_t key_length = 0;
+        if (_json_read_string(reader, &key_length) < 0) {
+                return -1;
+        }
+        if (_json_is_string_type(key_type)) {
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, key_type, reader->buffer));
+                return 0;
+        }
+        return _json_append_basic_from_text(message, key_type, reader->buffer);
+}
+
+static int _json_append_array(_Json_reader* reader, sd_bus_message* message, const SdBusSignatureNode* node) {
+        const SdBusSignatureNode* element_node = node + 1;
+        if (element_node->type == 'y') {
+                size_t bytes_length = 0;
+                if (_json_read_base64(reader, &bytes_length) < 0) {
+                        return -1;
+                }
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_array(message, 'y', reader->buffer, bytes_length));
+                return 0;
+        }
+
+        int is_dict = element_node->type == 'e';
+        char closing_char = is_dict ? '}' : ']';
+        if (_json_expect(reader, is_dict ? '{' : '[') < 0) {
+                return -1;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_open_container(message, 'a', node->contents));
+        if (_json_peek(reader) == closing_char) {
+                reader->index++;
+                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_close_container(message));
+                return 0;
+        }
+        while (1) {
+                if (is_dict) {
+                        const SdBusSignatureNode* key_node = element_node + 1;
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_open_container(message, 'e', element_node->contents));
+                        if (_json_append_key(reader, message, key_node->type) < 0 || _json_expect(reader, ':') < 0 ||
+                            _json_append_complete(reader, message, key_node + 1) < 0) {
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_close_container(message));
+                } else if (_json_append_complete(reader, message, element_node) < 0) {
+                        return -1;
+                }
+                if (_json_peek(reader) != ',') {
+                        break;
+                }
+                reader->index++;
+        }
+        if (_json_expect(reader, closing_char) < 0) {
+                return -1;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_close_container(message));
+        return 0;
+}
+
+static int _json_append_fields(_Json_reader* reader, sd_bus_message* message, const SdBusSignatureNode* first_field_node, size_t fields_count) {
+        if (_json_expect(reader, '[') < 0) {
+                return -1;
+        }
+        const SdBusSignatureNode* field_node = first_field_node;
+        for (size_t i = 0; i < fields_count; ++i) {
+                if (i > 0 && _json_expect(reader, ',') < 0) {
+                        return -1;
+                }
+                if (_json_append_complete(reader, message, field_node) < 0) {
+                        return -1;
+                }
+                field_node += field_node->subtree_size;
+        }
+        return _json_expect(reader, ']');
+}
+
+static int _json_append_variant(_Json_reader* reader, sd_bus_message* message) {
+        size_t signature_length = 0;
+        if (_json_expect(reader, '[') < 0 || _json_read_string(reader, &signature_length) < 0) {
+                return -1;
+        }
+        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusSignaturePlan_get_from_char_ptr(reader->buffer));
+        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+        if (variant_plan->top_level_count != 1) {
+                PyErr_Format(PyExc_TypeError, "Variant signature must be a single complete type, got %s", reader->buffer);
+                return -1;
+        }
+        // Scratch buffer is reused by the value
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_open_container(message, 'v', variant_plan->nodes[0].signature));
+        if (_json_expect(reader, ',') < 0 || _json_append_complete(reader, message, &variant_plan->nodes[0]) < 0 || _json_expect(reader, ']') < 0) {
+                return -1;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_close_container(message));
+        return 0;
+}
+
+static int _json_append_complete(_Json_reader* reader, sd_bus_message* message, const SdBusSignatureNode* node) {
+        switch (node->type) {
+                case 'a': {
+                        return _json_append_array(reader, message, node);
+                }
+                case 'r': {
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_open_container(message, 'r', node->contents));
+                        if (_json_append_fields(reader, message, node + 1, node->children_count) < 0) {
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_close_container(message));
+                        return 0;
+                }
+                case 'v': {
+                        return _json_append_variant(reader, message);
+                }
+                case 's':
+                case 'o':
+                case 'g': {
+                        size_t string_length = 0;
+                        if (_json_read_string(reader, &string_length) < 0) {
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, node->type, reader->buffer));
+                        return 0;
+                }
+                case 'b': {
+                        int new_bool = _json_peek(reader) == 't';
+                        if (_json_expect_literal(reader, new_bool ? "true" : "false") < 0) {
+                                return -1;
+                        }
+                        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, 'b', &new_bool));
+                        return 0;
+                }
+                case 'd': {
+                        if (_json_peek(reader) == 'n') {
+                                if (_json_expect_literal(reader, "null") < 0) {
+                                        return -1;
+                                }
+                                double not_a_number = NAN;
+                                CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_append_basic(message, 'd', &not_a_number));
+                                return 0;
+                        }
+                        break;
+                }
+                default: {
+                        break;
+                }
+        }
+        char number_str[64] = {0};
+        if (_json_read_number(reader, number_str, sizeof(number_str)) < 0) {
+                return -1;
+        }
+        return _json_append_basic_from_text(message, node->type, number_str);
+}
+
+int _SdBusJson_load_message(sd_bus_message* message, const SdBusSignaturePlan* plan, const char* json_data, size_t json_length) {
+        _Json_reader reader __attribute__((cleanup(_cleanup_json_reader))) = {
+            .data = json_data,
+            .length = json_length,
+        };
+        int return_value = 0;
+        if (plan->top_level_count == 0) {
+                return_value = _json_expect_literal(&reader, "null");
+        } else if (plan->top_level_count == 1) {
+                return_value = _json_append_complete(&reader, message, plan->nodes);
+        } else {
+                return_value = _json_append_fields(&reader, message, plan->nodes, plan->top_level_count);
+        }
+        if (return_value < 0) {
+                return -1;
+        }
+        if (_json_peek(&reader) != '\0') {
+                return _json_syntax_error(&reader, "end of JSON");
+        }
+        return 0;
+}
@@ -18,8 +18,16 @@
     License along with this library; if not, write to the Free Software
     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 */
+// Python.h has to come first to define _GNU_SOURCE
 #include "sd_bus_internals.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 void _SdBusMessage_set_messsage(SdBusMessageObject* self, sd_bus_message* new_message) {
         self->message_ref = sd_bus_message_ref(new_message);
 }
@@ -30,7 +38,7 @@ static void SdBusMessage_dealloc(SdBusMessageObject* self) {
         SD_BUS_DEALLOC_TAIL;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusMessage_seal(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
         uint64_t cookie = 0, timeout = 0;
         if (nargs > 2) {
@@ -48,6 +56,7 @@ static PyObject* SdBusMessage_seal(SdBusMessageObject* self, PyObject* args) {
         uint64_t cookie = 0, timeout = 0;
         CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "|KK", &cookie, &timeout, NULL));
 #endif
+        self->lazy_cursor_owner = NULL;
         CALL_SD_BUS_AND_CHECK(sd_bus_message_seal(self->message_ref, cookie, timeout));
         Py_RETURN_NONE;
 }
@@ -60,21 +69,173 @@ static PyObject* SdBusMessage_dump(SdBusMessageObject* self, PyObject* Py_UNUSED
 
 typedef struct {
         sd_bus_message* message;
-        const char* container_char_ptr;
-        size_t index;
-        size_t max_index;
+        unsigned long flags;
+        PyObject* struct_types;    // Struct signature to type dict of this call or NULL
+        // Signatures of inferred containers keyed by object address or NULL
+        PyObject* inferred_signatures;
+        // Decode limits or NULL and the budget used so far
+        const SdBusDecodeLimits* limits;
+        SdBusDecodeBudget* budget;
+        size_t depth;
 } _Parse_state;
 
-#define _CHECK_PARSER_NOT_NULL(parser)                                        \
-        if (parser_state->container_char_ptr[parser_state->index] == '\0') {  \
-                PyErr_SetString(PyExc_TypeError, "Data signature too short"); \
-                return NULL;                                                  \
+const SdBusDecodeLimits* _SdBusDecodeLimits_or_null(const SdBusDecodeLimits* limits) {
+        if (limits->max_depth == 0 && limits->max_elements == 0 && limits->max_string_bytes == 0 && limits->max_objects == 0) {
+                return NULL;
+        }
+        return limits;
+}
+
+static int _decode_limits_set_from_objects(SdBusDecodeLimits* limits, PyObject* const* limit_objects) {
+        unsigned long new_limits[4] = {0};
+        for (size_t i = 0; i < 4; ++i) {
+                new_limits[i] = PyLong_AsUnsignedLong(limit_objects[i]);
+                if (PyErr_Occurred()) {
+                        return -1;
+                }
+        }
+        limits->max_depth = new_limits[0];
+        limits->max_elements = new_limits[1];
+        limits->max_string_bytes = new_limits[2];
+        limits->max_objects = new_limits[3];
+        return 0;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+int _SdBusDecodeLimits_from_args(SdBusDecodeLimits* limits, PyObject* const* args, Py_ssize_t nargs) {
+        if (nargs != 4) {
+                PyErr_Format(PyExc_TypeError, "Expected 4 arguments, got %zd", nargs);
+                return -1;
+        }
+        return _decode_limits_set_from_objects(limits, args);
+}
+#else
+int _SdBusDecodeLimits_from_args(SdBusDecodeLimits* limits, PyObject* args) {
+        PyObject* limit_objects[4] = {NULL};
+        if (!PyArg_ParseTuple(args, "OOOO", &limit_objects[0], &limit_objects[1], &limit_objects[2], &limit_objects[3], NULL)) {
+                return -1;
+        }
+        return _decode_limits_set_from_objects(limits, limit_objects);
+}
+#endif
+
+static int _decode_limit_exceeded(const char* limit_name, unsigned long limit) {
+        PyObject* error_name_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyUnicode_FromString(SD_BUS_ERROR_LIMITS_EXCEEDED));
+        PyObject* exception_to_raise = PyDict_GetItemWithError(dbus_error_to_exception_dict, error_name_str);
+        if (exception_to_raise == NULL) {
+                if (PyErr_Occurred()) {
+                        return -1;
+                }
+                // DbusLimitsExceededError is registered by sdbus package
+                exception_to_raise = exception_lib;
+        }
+        PyErr_Format(exception_to_raise, "Message exceeds the decode limit of %lu %s", limit, limit_name);
+        return -1;
+}
+
+static int _decode_budget_charge(_Parse_state* parser, size_t objects, size_t elements, size_t string_bytes) {
+        const SdBusDecodeLimits* limits = parser->limits;
+        SdBusDecodeBudget* budget = parser->budget;
+        budget->objects_count += objects;
+        budget->elements_count += elements;
+        budget->string_bytes += string_bytes;
+        if (limits->max_objects != 0 && budget->objects_count > limits->max_objects) {
+                return _decode_limit_exceeded("objects", limits->max_objects);
+        }
+        if (limits->max_elements != 0 && budget->elements_count > limits->max_elements) {
+                return _decode_limit_exceeded("elements", limits->max_elements);
+        }
+        if (limits->max_string_bytes != 0 && budget->string_bytes > limits->max_string_bytes) {
+                return _decode_limit_exceeded("string bytes", limits->max_string_bytes);
+        }
+        return 0;
+}
+
+static int _decode_budget_check_depth(_Parse_state* parser) {
+        // Called before entering a container at the current depth
+        if (parser->limits->max_depth != 0 && parser->depth >= parser->limits->max_depth) {
+                return _decode_limit_exceeded("nesting depth", parser->limits->max_depth);
         }
+        return 0;
+}
+
+// Budget is only tracked when decoding with limits. Checked before
+// the Python objects are created so that the limits bound the memory.
+#define SD_BUS_PY_DECODE_CHARGE(parser, objects, elements, string_bytes)                               \
+        if (parser->limits != NULL) {                                                                  \
+                CALL_PYTHON_INT_CHECK(_decode_budget_charge(parser, objects, elements, string_bytes)); \
+        }
+
+static PyObject* _parse_complete(PyObject* complete_obj, _Parse_state* parser_state, const SdBusSignatureNode* node);
+
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+#define SD_BUS_PY_CHECK_BUFFER PyObject_CheckBuffer
+#else
+static int _check_memory_view(PyObject* maybe_buffer) {
+        PyObject* memory_view = PyMemoryView_FromObject(maybe_buffer);
+        if (memory_view == NULL) {
+                PyErr_Clear();
+                return 0;
+        }
+        Py_DECREF(memory_view);
+        return 1;
+}
+
+#define SD_BUS_PY_CHECK_BUFFER _check_memory_view
+#endif
+
+char variant_inferred_int_type = 'x';
+
+static int _create_memfd(const char* data, size_t data_size) {
+        int memfd = memfd_create("python-sdbus", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (memfd < 0) {
+                return -errno;
+        }
+        size_t written_size = 0;
+        while (written_size < data_size) {
+                ssize_t write_return = write(memfd, data + written_size, data_size - written_size);
+                if (write_return < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+                        int write_errno = errno;
+                        close(memfd);
+                        return -write_errno;
+                }
+                written_size += (size_t)write_return;
+        }
+        return memfd;
+}
 
-static PyObject* _parse_complete(PyObject* complete_obj, _Parse_state* parser_state);
+static PyObject* _append_sealed_memfd(_Parse_state* parser_state, PyObject* payload_object) {
+        // Data of SealedMemfd passed as unix fd is sent as
+        // a sealed memfd. Receiver can map it without copying.
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+        Py_buffer payload_buffer CLEANUP_PY_BUFFER = {0};
+        CALL_PYTHON_INT_CHECK(PyObject_GetBuffer(payload_object, &payload_buffer, PyBUF_C_CONTIGUOUS));
+        const char* payload_ptr = payload_buffer.buf;
+        size_t payload_size = (size_t)payload_buffer.len;
+#else
+        PyObject* payload_memory_view CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyMemoryView_FromObject(payload_object));
+        PyObject* payload_bytes CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(payload_memory_view, "tobytes", NULL));
+        const char* payload_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(payload_bytes);
+        size_t payload_size = (size_t)PyBytes_Size(payload_bytes);
+#endif
+        int memfd = CALL_SD_BUS_AND_CHECK(_create_memfd(payload_ptr, payload_size));
+        int append_return = 0;
+        if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+                append_return = -errno;
+        } else {
+                // sd-bus duplicates the fd
+                append_return = sd_bus_message_append_basic(parser_state->message, 'h', &memfd);
+        }
+        close(memfd);
+        CALL_SD_BUS_AND_CHECK(append_return);
+        Py_RETURN_NONE;
+}
 
-static PyObject* _parse_basic(PyObject* basic_obj, _Parse_state* parser_state) {
-        char basic_type = parser_state->container_char_ptr[parser_state->index];
+static PyObject* _parse_basic(PyObject* basic_obj, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        char basic_type = node->type;
         switch (basic_type) {
                 // Unsigned
                 case 'y': {
@@ -184,6 +345,13 @@ static PyObject* _parse_basic(PyObject* basic_obj, _Parse_state* parser_state) {
                         break;
                 }
                 case 'h': {
+                        if (Py_TYPE(basic_obj) == (PyTypeObject*)SealedMemfd_class) {
+                                if (((SealedMemfdObject*)basic_obj)->data == NULL) {
+                                        PyErr_SetString(PyExc_TypeError, "SealedMemfd is not initialized");
+                                        return NULL;
+                                }
+                                return _append_sealed_memfd(parser_state, ((SealedMemfdObject*)basic_obj)->data);
+                        }
                         long long the_long_long = PyLong_AsLongLong(basic_obj);
                         PYTHON_ERR_OCCURED;
                         int h_to_add = (int)the_long_long;
@@ -225,7 +393,7 @@ static PyObject* _parse_basic(PyObject* basic_obj, _Parse_state* parser_state) {
                                              basic_obj);
                                 return NULL;
                         }
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
                         const char* char_ptr_to_append = SD_BUS_PY_UNICODE_AS_CHAR_PTR(basic_obj);
 #else
                         PyObject* bytes_to_append CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(basic_obj);
@@ -239,199 +407,221 @@ static PyObject* _parse_basic(PyObject* basic_obj, _Parse_state* parser_state) {
                         return NULL;
                         break;
         }
-        parser_state->index++;
         Py_RETURN_NONE;
 }
 
-static size_t _find_struct_end(const char* container_char_ptr, size_t current_index) {
-        // Initial state
-        // "...(...)..."
-        //      ^
-        int round_bracket_count = 1;
-        for (; container_char_ptr[current_index] != '\0'; ++current_index) {
-                char current_char = container_char_ptr[current_index];
-                if (current_char == ')') {
-                        --round_bracket_count;
-                }
+static PyObject* _parse_dict(PyObject* dict_object, _Parse_state* parser_state, const SdBusSignatureNode* dict_node) {
+        // dict_node is the dict entry
+        // "a{sx}"
+        //   ^
+        if (!PyDict_Check(dict_object)) {
+                PyErr_Format(PyExc_TypeError, "Message append error, expected dict got %R", dict_object);
+                return NULL;
+        }
 
-                if (current_char == '(') {
-                        ++round_bracket_count;
-                }
+        const SdBusSignatureNode* key_node = dict_node + 1;
+        const SdBusSignatureNode* value_node = key_node + key_node->subtree_size;
 
-                if (round_bracket_count == 0) {
-                        return current_index;
-                }
+        PyObject *key, *value;
+        Py_ssize_t pos = 0;
 
-                if (round_bracket_count < 0) {
-                        PyErr_SetString(PyExc_TypeError,
-                                        "Round braces count <0. Check "
-                                        "your signature.");
-                        return 0;
-                }
+        while (PyDict_Next(dict_object, &pos, &key, &value)) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'e', dict_node->contents));
+                CALL_PYTHON_EXPECT_NONE(_parse_basic(key, parser_state, key_node));
+                CALL_PYTHON_EXPECT_NONE(_parse_complete(value, parser_state, value_node));
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
         }
-        PyErr_SetString(PyExc_TypeError, "Reached the end of signature before the struct end");
-        return 0;
-}
-
-static size_t _find_dict_end(const char* container_char_ptr, size_t current_index) {
-        // Initial state
-        // "...a{..}..."
-        //      ^
-        int curly_bracket_count = 0;
-        for (; container_char_ptr[current_index] != '\0'; ++current_index) {
-                char current_char = container_char_ptr[current_index];
-                if (current_char == '}') {
-                        --curly_bracket_count;
-                }
-
-                if (current_char == '{') {
-                        ++curly_bracket_count;
-                }
 
-                if (curly_bracket_count == 0) {
-                        // "...a{..}..."
-                        //         ^
-                        return current_index;
-                }
+        Py_RETURN_NONE;
+}
 
-                if (curly_bracket_count < 0) {
-                        PyErr_SetString(PyExc_TypeError,
-                                        "Curly braces count <0. Check "
-                                        "your signature.");
+static size_t _fixed_width_type_size(char element_type) {
+        switch (element_type) {
+                case 'y':
+                        return sizeof(uint8_t);
+                case 'n':
+                case 'q':
+                        return sizeof(uint16_t);
+                case 'i':
+                case 'u':
+                        return sizeof(uint32_t);
+                case 'x':
+                case 't':
+                case 'd':
+                        return sizeof(uint64_t);
+                default:
+                        // Unix fds need to be duplicated one by one and
+                        // sd-bus does not accept booleans as trivial array.
                         return 0;
-                }
         }
-        PyErr_SetString(PyExc_TypeError, "Reached the end of signature before the struct end");
-        return 0;
 }
 
-static size_t _find_array_end(const char* container_char_ptr, size_t current_index) {
-        // Initial state
-        // "...as..."
-        //     ^
-        // "...a{sx}.."
-        //     ^
-        // "...a(as)..."
-        //     ^
-
-        while (container_char_ptr[current_index] == 'a') {
-                current_index++;
+static int _buffer_format_matches(const char* format, char element_type) {
+        // NULL format means unsigned bytes
+        if (format == NULL) {
+                return element_type == 'y';
         }
-        char current_char = container_char_ptr[current_index];
-        // "...as..."
-        //      ^
-        // "...a{sx}.."
-        //      ^
-        // "...a(as)..."
-        //      ^
-        if (current_char == '\0') {
-                PyErr_SetString(PyExc_TypeError,
-                                "Reached the end of signature before "
-                                "the array end");
+        // Only native byte order is allowed as sd-bus
+        // will marshal the data as is.
+        switch (format[0]) {
+                case '@':
+                case '=':
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                case '<':
+#else
+                case '>':
+                case '!':
+#endif
+                        format++;
+                        break;
+                default:
+                        break;
+        }
+        if (format[0] == '\0' || format[1] != '\0') {
                 return 0;
         }
-        if (current_char == '{') {
-                // "...a{sx}.."
-                //      ^
-                return _find_dict_end(container_char_ptr, current_index);
-        }
-        if (current_char == '(') {
-                current_index++;
-                // "...a(as)..."
-                //       ^
-                return _find_struct_end(container_char_ptr, current_index);
-        }
-
-        return current_index;
-}
-
-static const char* _subscript_char_ptr(const char* old_char_ptr, size_t start, size_t end) {
-        // "abc(def)..."
-        //  01234 |
-        //  0123456
-        // 6 - 4 = 2
-        // Actual string
-        // 'def\0'
-        // 3 string length without \0
-        // 4 string length with \0
-        size_t new_string_size = (end - start) + 1;
-        char* new_string = malloc(new_string_size + 1);
-        if (new_string == NULL) {
-                return NULL;
+        switch (element_type) {
+                case 'y':
+                        return strchr("BHILQNc", format[0]) != NULL;
+                case 'q':
+                case 'u':
+                case 't':
+                        return strchr("BHILQN", format[0]) != NULL;
+                case 'n':
+                case 'i':
+                case 'x':
+                        return strchr("bhilqn", format[0]) != NULL;
+                case 'd':
+                        return format[0] == 'd';
+                default:
+                        return 0;
         }
-        memcpy(new_string, old_char_ptr + start, new_string_size);
-        // Set last byte to NUL
-        new_string[new_string_size] = '\0';
-        return new_string;
 }
 
-static PyObject* _parse_dict(PyObject* dict_object, _Parse_state* parser_state) {
-        // parser_state->container_char_ptr
-        // "{sx}"
-        //  ^
-        if (!PyDict_Check(dict_object)) {
-                PyErr_Format(PyExc_TypeError, "Message append error, expected dict got %R", dict_object);
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+static PyObject* _parse_fixed_width_buffer(PyObject* buffer_object, _Parse_state* parser_state, char element_type) {
+        size_t element_size = _fixed_width_type_size(element_type);
+        Py_buffer buffer CLEANUP_PY_BUFFER = {0};
+        CALL_PYTHON_INT_CHECK(PyObject_GetBuffer(buffer_object, &buffer, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT));
+
+        if ((size_t)buffer.itemsize != element_size || !_buffer_format_matches(buffer.format, element_type)) {
+                PyErr_Format(PyExc_TypeError, "Buffer of format '%s' and item size %zd can't be appended as 'a%c' array",
+                             buffer.format != NULL ? buffer.format : "B", buffer.itemsize, (int)element_type);
                 return NULL;
         }
 
-        const char* dict_sig_char_ptr CLEANUP_STR_MALLOC = _subscript_char_ptr(parser_state->container_char_ptr, 1, parser_state->max_index - 2);
-        // "sx"
-        parser_state->container_char_ptr = dict_sig_char_ptr;  // This is OK because its cleanup from
-                                                               // outside
-        parser_state->max_index = strlen(dict_sig_char_ptr);
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_append_array(parser_state->message, element_type, buffer.buf, (size_t)buffer.len));
+        Py_RETURN_NONE;
+}
+#else
+static PyObject* _parse_fixed_width_buffer(PyObject* buffer_object, _Parse_state* parser_state, char element_type) {
+        // Without the buffer protocol go through memoryview attributes
+        // and copy the data once in to bytes.
+        size_t element_size = _fixed_width_type_size(element_type);
+        PyObject* memory_view CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyMemoryView_FromObject(buffer_object));
+        PyObject* format_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(memory_view, "format"));
+        PyObject* format_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(format_str);
+        const char* format_char_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(format_bytes);
+        PyObject* item_size_int CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(memory_view, "itemsize"));
+        Py_ssize_t item_size = PyLong_AsSsize_t(item_size_int);
+        PYTHON_ERR_OCCURED;
+
+        if ((size_t)item_size != element_size || !_buffer_format_matches(format_char_ptr, element_type)) {
+                PyErr_Format(PyExc_TypeError, "Buffer of format '%s' and item size %zd can't be appended as 'a%c' array", format_char_ptr, item_size,
+                             (int)element_type);
+                return NULL;
+        }
 
-        PyObject *key, *value;
-        Py_ssize_t pos = 0;
+        PyObject* data_bytes CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(memory_view, "tobytes", NULL));
+        const char* data_char_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(data_bytes);
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_append_array(parser_state->message, element_type, data_char_ptr, (size_t)PyBytes_Size(data_bytes)));
+        Py_RETURN_NONE;
+}
+#endif
 
-        while (PyDict_Next(dict_object, &pos, &key, &value)) {
-                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'e', dict_sig_char_ptr));
-                parser_state->index = 0;
-                CALL_PYTHON_EXPECT_NONE(_parse_basic(key, parser_state));
-                CALL_PYTHON_EXPECT_NONE(_parse_complete(value, parser_state));
+static PyObject* _parse_string_array(PyObject* array_object, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        // "as", "ao", "ag" from list or tuple of str
+        char element_type = (node + 1)->type;
+        int is_list = PyList_Check(array_object);
+        Py_ssize_t array_size = is_list ? SD_BUS_PY_LIST_GET_SIZE(array_object) : SD_BUS_PY_TUPLE_GET_SIZE(array_object);
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+        for (Py_ssize_t i = 0; i < array_size; ++i) {
+                PyObject* string_object = is_list ? SD_BUS_PY_LIST_GET_ITEM(array_object, i) : SD_BUS_PY_TUPLE_GET_ITEM(array_object, i);
+                if (!PyUnicode_Check(string_object)) {
+                        PyErr_Format(PyExc_TypeError, "Message append error, expected str got %R", string_object);
+                        return NULL;
+                }
+                Py_ssize_t utf8_size = 0;
+                const char* utf8_char_ptr = PyUnicode_AsUTF8AndSize(string_object, &utf8_size);
+                if (utf8_char_ptr == NULL) {
+                        return NULL;
+                }
+                if (element_type != 's') {
+                        // Object paths and signatures have to be validated by sd-bus
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_append_basic(parser_state->message, element_type, utf8_char_ptr));
+                        continue;
+                }
+                // Length is already known so copy directly in to the message
+                if (memchr(utf8_char_ptr, '\0', (size_t)utf8_size) != NULL) {
+                        PyErr_SetString(PyExc_ValueError, "embedded null character");
+                        return NULL;
+                }
+                char* string_space = NULL;
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_append_string_space(parser_state->message, (size_t)utf8_size, &string_space));
+                memcpy(string_space, utf8_char_ptr, (size_t)utf8_size);
+        }
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
+#else
+        // Encode all strings first and append them with a single call
+        PyObject* bytes_list CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyList_New(array_size));
+        void* strv_memory CLEANUP_PYMEM_PTR = PyMem_Calloc((size_t)array_size + 1, sizeof(char*));
+        if (strv_memory == NULL) {
+                return PyErr_NoMemory();
+        }
+        char** strv = strv_memory;
+        for (Py_ssize_t i = 0; i < array_size; ++i) {
+                PyObject* string_object = is_list ? SD_BUS_PY_LIST_GET_ITEM(array_object, i) : SD_BUS_PY_TUPLE_GET_ITEM(array_object, i);
+                if (!PyUnicode_Check(string_object)) {
+                        PyErr_Format(PyExc_TypeError, "Message append error, expected str got %R", string_object);
+                        return NULL;
+                }
+                PyObject* string_bytes = SD_BUS_PY_UNICODE_AS_BYTES(string_object);
+                CALL_PYTHON_INT_CHECK(PyList_SetItem(bytes_list, i, string_bytes));
+                Py_ssize_t utf8_size = 0;
+                CALL_PYTHON_INT_CHECK(PyBytes_AsStringAndSize(string_bytes, &strv[i], &utf8_size));
+                if ((size_t)utf8_size != strlen(strv[i])) {
+                        PyErr_SetString(PyExc_ValueError, "embedded null character");
+                        return NULL;
+                }
+        }
+        if (element_type == 's') {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_append_strv(parser_state->message, strv));
+        } else {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+                for (Py_ssize_t i = 0; i < array_size; ++i) {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_append_basic(parser_state->message, element_type, strv[i]));
+                }
                 CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
         }
-
+#endif
         Py_RETURN_NONE;
 }
 
-static PyObject* _parse_array(PyObject* array_object, _Parse_state* parser_state) {
-        // Initial state
+static PyObject* _parse_array(PyObject* array_object, _Parse_state* parser_state, const SdBusSignatureNode* node) {
         // "...as..."
         //     ^
         // "...a{sx}.."
         //     ^
         // "...a(as)..."
         //     ^
-        size_t array_end = _find_array_end(parser_state->container_char_ptr, parser_state->index);
-        if (array_end == 0) {
-                return NULL;
-        }
-        // Array end points to
-        // "...as..."
-        //      ^
-        // "...a{sx}.."
-        //         ^
-        // "...a(as)..."
-        //         ^
-        const char* array_sig_char_ptr CLEANUP_STR_MALLOC = _subscript_char_ptr(parser_state->container_char_ptr, parser_state->index + 1, array_end);
-        // array_sig_char_ptr
-        // "...as..."
-        //     "s"
-        // "...a{sx}.."
-        //     "{sx}"
-        // "...a(as)..."
-        //     "(as)"
-        _Parse_state array_parser = {
-            .message = parser_state->message,
-            .container_char_ptr = array_sig_char_ptr,
-            .index = 0,
-            .max_index = strlen(array_sig_char_ptr),
-        };
-        if (array_parser.container_char_ptr[0] == '{') {
-                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', array_sig_char_ptr));
-                CALL_PYTHON_EXPECT_NONE(_parse_dict(array_object, &array_parser));
+        const SdBusSignatureNode* element_node = node + 1;
+
+        if (element_node->type == 'e') {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+                CALL_PYTHON_EXPECT_NONE(_parse_dict(array_object, parser_state, element_node));
                 CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
-        } else if (array_parser.container_char_ptr[0] == 'y') {
+        } else if (element_node->type == 'y') {
                 char* char_ptr_to_add = NULL;
                 ssize_t size_of_array = 0;
                 if (PyByteArray_Check(array_object)) {
@@ -453,6 +643,9 @@ static PyObject* _parse_array(PyObject* array_object, _Parse_state* parser_state
                                 return NULL;
                         }
                 } else {
+                        if (SD_BUS_PY_CHECK_BUFFER(array_object)) {
+                                return _parse_fixed_width_buffer(array_object, parser_state, 'y');
+                        }
                         PyErr_Format(PyExc_TypeError,
                                      "Expected bytes or byte "
                                      "array, got %R",
@@ -461,181 +654,472 @@ static PyObject* _parse_array(PyObject* array_object, _Parse_state* parser_state
                 }
                 CALL_SD_BUS_AND_CHECK(sd_bus_message_append_array(parser_state->message, 'y', char_ptr_to_add, (size_t)size_of_array));
         } else {
-                if (!PyList_Check(array_object)) {
-                        PyErr_Format(PyExc_TypeError,
-                                     "Message append error, "
-                                     "expected array got %R",
-                                     array_object);
-                        return NULL;
+                if (_fixed_width_type_size(element_node->type) != 0 && !PyList_Check(array_object) && SD_BUS_PY_CHECK_BUFFER(array_object)) {
+                        // array.array, memoryview, numpy arrays...
+                        return _parse_fixed_width_buffer(array_object, parser_state, element_node->type);
                 }
-
-                // "...as..."
-                //     "s"
-                // "...aa{sx}.."
-                //     "a{sx}"
-                // "...a(as)..."
-                //     "(as)"
-                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', array_sig_char_ptr));
-                for (Py_ssize_t i = 0; i < SD_BUS_PY_LIST_GET_SIZE(array_object); ++i) {
-                        CALL_PYTHON_EXPECT_NONE(_parse_complete(SD_BUS_PY_LIST_GET_ITEM(array_object, i), &array_parser));
-                        array_parser.index = 0;
+                if ((element_node->type == 's' || element_node->type == 'o' || element_node->type == 'g') &&
+                    (PyList_Check(array_object) || PyTuple_Check(array_object))) {
+                        return _parse_string_array(array_object, parser_state, node);
+                }
+                if (PyList_Check(array_object)) {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+                        for (Py_ssize_t i = 0; i < SD_BUS_PY_LIST_GET_SIZE(array_object); ++i) {
+                                CALL_PYTHON_EXPECT_NONE(_parse_complete(SD_BUS_PY_LIST_GET_ITEM(array_object, i), parser_state, element_node));
+                        }
+                } else if (PyTuple_Check(array_object)) {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+                        for (Py_ssize_t i = 0; i < SD_BUS_PY_TUPLE_GET_SIZE(array_object); ++i) {
+                                CALL_PYTHON_EXPECT_NONE(_parse_complete(SD_BUS_PY_TUPLE_GET_ITEM(array_object, i), parser_state, element_node));
+                        }
+                } else {
+                        // Strings, bytes and dicts are iterable but
+                        // almost certainly passed by mistake.
+                        if (PyUnicode_Check(array_object) || PyBytes_Check(array_object) || PyByteArray_Check(array_object) ||
+                            PyDict_Check(array_object)) {
+                                PyErr_Format(PyExc_TypeError,
+                                             "Message append error, "
+                                             "expected array got %R",
+                                             array_object);
+                                return NULL;
+                        }
+                        // Generators, dict views, custom sequences...
+                        // Elements are appended as they are produced.
+                        PyObject* array_iter CLEANUP_PY_OBJECT = PyObject_GetIter(array_object);
+                        if (array_iter == NULL) {
+                                if (!PyErr_ExceptionMatches(PyExc_TypeError)) {
+                                        return NULL;
+                                }
+                                PyErr_Clear();
+                                PyErr_Format(PyExc_TypeError,
+                                             "Message append error, "
+                                             "expected array got %R",
+                                             array_object);
+                                return NULL;
+                        }
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'a', node->contents));
+                        while (1) {
+                                PyObject* next_item CLEANUP_PY_OBJECT = PyIter_Next(array_iter);
+                                if (next_item == NULL) {
+                                        PYTHON_ERR_OCCURED;
+                                        break;
+                                }
+                                CALL_PYTHON_EXPECT_NONE(_parse_complete(next_item, parser_state, element_node));
+                        }
                 }
                 CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
         }
-        parser_state->index = array_end + 1;
-        // index points to
-        // "...as..."
-        //       ^
-        // "...a{sx}.."
-        //          ^
-        // "...a(as)..."
-        //          ^
         Py_RETURN_NONE;
 }
 
-static PyObject* _parse_struct(PyObject* tuple_object, _Parse_state* parser_state) {
-        // Initial state
-        // "...(...)..."
-        //     ^
-        if (!PyTuple_Check(tuple_object)) {
-                PyErr_Format(PyExc_TypeError, "Message append error, expected tuple got %R", tuple_object);
-                return NULL;
+PyObject* _SdBusStructType_get_fields(PyObject* struct_type) {
+        // Field names of NamedTuple or dataclass or None for other types.
+        // Borrowed reference.
+        PyObject* cached_fields = PyDict_GetItemWithError(struct_type_fields_cache, struct_type);
+        if (cached_fields != NULL) {
+                return cached_fields;
         }
-        parser_state->index++;
-        // "...(...)..."
-        //      ^
-        size_t struct_end = _find_struct_end(parser_state->container_char_ptr, parser_state->index);
+        PYTHON_ERR_OCCURED;
+
+        PyObject* new_fields CLEANUP_PY_OBJECT = NULL;
+        if (PyType_Check(struct_type) && PyType_IsSubtype((PyTypeObject*)struct_type, &PyTuple_Type)) {
+                // NamedTuple
+                PyObject* named_tuple_fields CLEANUP_PY_OBJECT = PyObject_GetAttrString(struct_type, "_fields");
+                if (named_tuple_fields == NULL) {
+                        PyErr_Clear();
+                } else {
+                        new_fields = CALL_PYTHON_AND_CHECK(PySequence_Tuple(named_tuple_fields));
+                }
+        } else {
+                PyObject* dataclass_fields CLEANUP_PY_OBJECT = PyObject_CallFunctionObjArgs(dataclasses_fields_func, struct_type, NULL);
+                if (dataclass_fields == NULL) {
+                        if (!PyErr_ExceptionMatches(PyExc_TypeError)) {
+                                return NULL;
+                        }
+                        PyErr_Clear();
+                } else {
+                        Py_ssize_t fields_count = PyObject_Size(dataclass_fields);
+                        PYTHON_ERR_OCCURED;
+                        new_fields = CALL_PYTHON_AND_CHECK(PyTuple_New(fields_count));
+                        for (Py_ssize_t i = 0; i < fields_count; ++i) {
+                                PyObject* field CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PySequence_GetItem(dataclass_fields, i));
+                                PyObject* field_name = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(field, "name"));
+                                SD_BUS_PY_TUPLE_SET_ITEM(new_fields, i, field_name);
+                        }
+                }
+        }
+        if (new_fields == NULL) {
+                Py_INCREF(Py_None);
+                new_fields = Py_None;
+        }
+        CALL_PYTHON_INT_CHECK(PyDict_SetItem(struct_type_fields_cache, struct_type, new_fields));
+        return new_fields;
+}
 
-        if (struct_end == 0) {
+static PyObject* _parse_struct_fields(PyObject* struct_object, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        // Dataclasses are appended in the fields order without building a tuple
+        PyObject* struct_fields = CALL_PYTHON_AND_CHECK(_SdBusStructType_get_fields((PyObject*)Py_TYPE(struct_object)));
+        if (struct_fields == Py_None) {
+                PyErr_Format(PyExc_TypeError, "Message append error, expected tuple got %R", struct_object);
                 return NULL;
         }
-        // Struct end points to
-        // "...(...)..."
-        //         ^
-        const char* struct_signature CLEANUP_STR_MALLOC = _subscript_char_ptr(parser_state->container_char_ptr, parser_state->index, struct_end - 1);
-        // struct_signature should be
-        // "...(...)..."
-        //     ^   ^
-        //     "..."
-        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'r', struct_signature));
-        for (Py_ssize_t i = 0; i < SD_BUS_PY_TUPLE_GET_SIZE(tuple_object); ++i) {
-                // Use original parser as there is not much reason to
-                // create new one
-                CALL_PYTHON_EXPECT_NONE(_parse_complete(SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, i), parser_state));
+        Py_ssize_t fields_count = SD_BUS_PY_TUPLE_GET_SIZE(struct_fields);
+        if ((size_t)fields_count != node->children_count) {
+                PyErr_Format(PyExc_TypeError, "Struct %s expects %zu elements, got object with %zd fields", node->signature, node->children_count,
+                             fields_count);
+                return NULL;
+        }
+
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'r', node->contents));
+        const SdBusSignatureNode* field_node = node + 1;
+        for (Py_ssize_t i = 0; i < fields_count; ++i) {
+                PyObject* field_value CLEANUP_PY_OBJECT =
+                    CALL_PYTHON_AND_CHECK(PyObject_GetAttr(struct_object, SD_BUS_PY_TUPLE_GET_ITEM(struct_fields, i)));
+                CALL_PYTHON_EXPECT_NONE(_parse_complete(field_value, parser_state, field_node));
+                field_node += field_node->subtree_size;
         }
         CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
-        // "...(...)..."
-        //         ^
-        parser_state->index++;
-        // Final state
-        // "...(...)..."
-        //          ^
         Py_RETURN_NONE;
 }
 
-static PyObject* _parse_variant(PyObject* tuple_object, _Parse_state* parser_state) {
-        // Initial state "...v..."
-        //                   ^
+static PyObject* _parse_struct(PyObject* tuple_object, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        // "...(...)..."
+        //     ^
         if (!PyTuple_Check(tuple_object)) {
-                PyErr_Format(PyExc_TypeError, "Message append error, expected tuple got %R", tuple_object);
-                return NULL;
+                return _parse_struct_fields(tuple_object, parser_state, node);
         }
-        if (SD_BUS_PY_TUPLE_GET_SIZE(tuple_object) != 2) {
-                PyErr_Format(PyExc_TypeError, "Expected tuple of only 2 elements got %zi", SD_BUS_PY_TUPLE_GET_SIZE(tuple_object));
+        Py_ssize_t tuple_size = SD_BUS_PY_TUPLE_GET_SIZE(tuple_object);
+        if ((size_t)tuple_size != node->children_count) {
+                PyErr_Format(PyExc_TypeError, "Struct %s expects %zu elements, got tuple of %zd", node->signature, node->children_count, tuple_size);
                 return NULL;
         }
-        PyObject* variant_signature = SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, 0);
-#ifndef Py_LIMITED_API
-        const char* variant_signature_char_ptr = SD_BUS_PY_UNICODE_AS_CHAR_PTR(variant_signature);
-#else
-        PyObject* variant_signature_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(variant_signature);
-        const char* variant_signature_char_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(variant_signature_bytes);
-#endif
-        _Parse_state variant_parser = {
-            .message = parser_state->message,
-            .max_index = strlen(variant_signature_char_ptr),
-            .container_char_ptr = variant_signature_char_ptr,
-            .index = 0,
-        };
 
-        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'v', variant_signature_char_ptr));
-        PyObject* variant_body = SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, 1);
-        CALL_PYTHON_EXPECT_NONE(_parse_complete(variant_body, &variant_parser));
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'r', node->contents));
+        const SdBusSignatureNode* field_node = node + 1;
+        for (Py_ssize_t i = 0; i < tuple_size; ++i) {
+                CALL_PYTHON_EXPECT_NONE(_parse_complete(SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, i), parser_state, field_node));
+                field_node += field_node->subtree_size;
+        }
         CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
-
-        // Final state "...v..."
-        //                  ^
-        parser_state->index++;
         Py_RETURN_NONE;
 }
 
-static PyObject* _parse_complete(PyObject* complete_obj, _Parse_state* parser_state) {
-        // Initial state "..."
-        //                ^
-        _CHECK_PARSER_NOT_NULL(parser_state);
-        char next_char = parser_state->container_char_ptr[parser_state->index];
-        switch (next_char) {
-                case '}': {
-                        PyErr_SetString(PyExc_TypeError,
-                                        "End of dict reached instead "
-                                        "of complete type");
-                        return NULL;
-                }
-                case ')': {
-                        PyErr_SetString(PyExc_TypeError,
-                                        "End of struct reached "
-                                        "instead of complete type");
-                        return NULL;
+// Variant signature inference
+//
+// Plain Python values in variant positions get the signature from their types.
+// Tuples are explicit (signature, value) variants as usual so lists and dicts
+// of mixed values and empty ones use variant elements.
+//
+// Signatures of lists and dicts in mixed containers are remembered while
+// the outermost inferred variant is appended so that they are not inferred
+// again when appended to their own variant positions.
+
+typedef struct {
+        char signature[SD_BUS_PY_MAX_SIGNATURE_LENGTH];
+        size_t length;
+} _Inferred_signature;
+
+static int _infer_signature(PyObject* value_object, _Inferred_signature* inferred, PyObject* inferred_signatures);
+
+static int _infer_append(_Inferred_signature* inferred, const char* signature_part, size_t part_length) {
+        if (inferred->length + part_length >= SD_BUS_PY_MAX_SIGNATURE_LENGTH) {
+                PyErr_SetString(PyExc_TypeError, "Inferred variant signature too long");
+                return -1;
+        }
+        memcpy(inferred->signature + inferred->length, signature_part, part_length);
+        inferred->length += part_length;
+        inferred->signature[inferred->length] = '\0';
+        return 0;
+}
+
+static int _infer_remember(PyObject* value_object, const char* signature, PyObject* inferred_signatures) {
+        // Only containers are worth remembering, basic types are inferred at once
+        if (inferred_signatures == NULL || !(PyList_Check(value_object) || PyDict_Check(value_object))) {
+                return 0;
+        }
+        PyObject* address_object CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyLong_FromVoidPtr(value_object));
+        PyObject* signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusStringCache_get(signature));
+        // Value object is kept alive so that its address can't be reused
+        PyObject* remembered_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(PyTuple_Pack(2, value_object, signature_str));
+        return PyDict_SetItem(inferred_signatures, address_object, remembered_tuple);
+}
+
+static int _infer_elements_signature(PyObject* elements_list, _Inferred_signature* inferred, PyObject* inferred_signatures) {
+        // Common signature of all elements or variant if they differ
+        Py_ssize_t elements_count = SD_BUS_PY_LIST_GET_SIZE(elements_list);
+        if (elements_count == 0) {
+                return _infer_append(inferred, "v", 1);
+        }
+        _Inferred_signature first_signature = {.length = 0};
+        _Inferred_signature element_signature = {.length = 0};
+        if (_infer_signature(SD_BUS_PY_LIST_GET_ITEM(elements_list, 0), &first_signature, inferred_signatures) < 0) {
+                return -1;
+        }
+        for (Py_ssize_t i = 1; i < elements_count; ++i) {
+                element_signature.length = 0;
+                if (_infer_signature(SD_BUS_PY_LIST_GET_ITEM(elements_list, i), &element_signature, inferred_signatures) < 0) {
+                        return -1;
                 }
-                case '(': {
-                        // Struct == Tuple
-                        CALL_PYTHON_EXPECT_NONE(_parse_struct(complete_obj, parser_state));
-                        break;
+                if (element_signature.length == first_signature.length &&
+                    memcmp(element_signature.signature, first_signature.signature, first_signature.length) == 0) {
+                        continue;
                 }
-                case '{': {
-                        // Dict
-                        PyErr_SetString(PyExc_TypeError, "Dbus dict can't be outside of array");
-                        return NULL;
-                        break;
+                // Mixed elements are appended as variants of the signatures inferred so far
+                for (Py_ssize_t j = 0; j < i; ++j) {
+                        if (_infer_remember(SD_BUS_PY_LIST_GET_ITEM(elements_list, j), first_signature.signature, inferred_signatures) < 0) {
+                                return -1;
+                        }
                 }
-                case 'a': {
-                        // Array
-                        CALL_PYTHON_EXPECT_NONE(_parse_array(complete_obj, parser_state));
-                        break;
+                if (_infer_remember(SD_BUS_PY_LIST_GET_ITEM(elements_list, i), element_signature.signature, inferred_signatures) < 0) {
+                        return -1;
                 }
-                case 'v': {
-                        // Variant == (signature, data))
-                        CALL_PYTHON_EXPECT_NONE(_parse_variant(complete_obj, parser_state));
-                        break;
+                return _infer_append(inferred, "v", 1);
+        }
+        return _infer_append(inferred, first_signature.signature, first_signature.length);
+}
+
+static int _infer_key_signature(PyObject* dict_object, _Inferred_signature* inferred) {
+        Py_ssize_t dict_pos = 0;
+        PyObject* key_object = NULL;
+        PyObject* value_object = NULL;
+        char key_type = '\0';
+        while (PyDict_Next(dict_object, &dict_pos, &key_object, &value_object)) {
+                _Inferred_signature key_signature = {.length = 0};
+                if (_infer_signature(key_object, &key_signature, NULL) < 0) {
+                        return -1;
                 }
-                default: {
-                        // Basic type
-                        CALL_PYTHON_EXPECT_NONE(_parse_basic(complete_obj, parser_state));
-                        break;
+                if (key_signature.length != 1 || key_signature.signature[0] == 'v' ||
+                    (key_type != '\0' && key_signature.signature[0] != key_type)) {
+                        PyErr_Format(PyExc_TypeError, "Can't infer dict key type of %R", dict_object);
+                        return -1;
                 }
+                key_type = key_signature.signature[0];
         }
-        Py_RETURN_NONE;
+        if (key_type == '\0') {
+                key_type = 's';
+        }
+        return _infer_append(inferred, &key_type, 1);
 }
 
-#ifndef Py_LIMITED_API
-static PyObject* SdBusMessage_append_data(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
-        if (nargs < 2) {
-                PyErr_SetString(PyExc_TypeError, "Minimum 2 args required");
-                return NULL;
+static int _infer_signature(PyObject* value_object, _Inferred_signature* inferred, PyObject* inferred_signatures) {
+        // Bool is a subclass of int and has to be checked first
+        if (PyBool_Check(value_object)) {
+                return _infer_append(inferred, "b", 1);
         }
-        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
-
-        const char* signature_char_ptr = SD_BUS_PY_UNICODE_AS_CHAR_PTR(args[0]);
-
+        if (PyLong_Check(value_object)) {
+                return _infer_append(inferred, &variant_inferred_int_type, 1);
+        }
+        if (PyFloat_Check(value_object)) {
+                return _infer_append(inferred, "d", 1);
+        }
+        if (PyUnicode_Check(value_object)) {
+                return _infer_append(inferred, "s", 1);
+        }
+        if (PyBytes_Check(value_object) || PyByteArray_Check(value_object)) {
+                return _infer_append(inferred, "ay", 2);
+        }
+        if (PyTuple_Check(value_object)) {
+                return _infer_append(inferred, "v", 1);
+        }
+        if (PyList_Check(value_object)) {
+                if (_infer_append(inferred, "a", 1) < 0) {
+                        return -1;
+                }
+                return _infer_elements_signature(value_object, inferred, inferred_signatures);
+        }
+        if (PyDict_Check(value_object)) {
+                if (_infer_append(inferred, "a{", 2) < 0) {
+                        return -1;
+                }
+                if (_infer_key_signature(value_object, inferred) < 0) {
+                        return -1;
+                }
+                PyObject* dict_values CLEANUP_PY_OBJECT = PyDict_Values(value_object);
+                if (dict_values == NULL) {
+                        return -1;
+                }
+                if (_infer_elements_signature(dict_values, inferred, inferred_signatures) < 0) {
+                        return -1;
+                }
+                return _infer_append(inferred, "}", 1);
+        }
+        PyErr_Format(PyExc_TypeError, "Can't infer variant signature of %R", value_object);
+        return -1;
+}
+
+static PyObject* _parse_inferred_variant_value(PyObject* value_object, _Parse_state* parser_state) {
+        PyObject* address_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyLong_FromVoidPtr(value_object));
+        PyObject* remembered_tuple = PyDict_GetItemWithError(parser_state->inferred_signatures, address_object);
+        PyObject* variant_signature CLEANUP_PY_OBJECT = NULL;
+        if (remembered_tuple != NULL) {
+                variant_signature = SD_BUS_PY_TUPLE_GET_ITEM(remembered_tuple, 1);
+                Py_INCREF(variant_signature);
+        } else {
+                PYTHON_ERR_OCCURED;
+                _Inferred_signature inferred = {.length = 0};
+                CALL_PYTHON_INT_CHECK(_infer_signature(value_object, &inferred, parser_state->inferred_signatures));
+                // Repeated shapes resolve to the same cached signature string and plan
+                variant_signature = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(inferred.signature));
+        }
+        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(variant_signature));
+        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'v', variant_plan->nodes[0].signature));
+        CALL_PYTHON_EXPECT_NONE(_parse_complete(value_object, parser_state, &variant_plan->nodes[0]));
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
+
+        Py_RETURN_NONE;
+}
+
+static PyObject* _parse_inferred_variant(PyObject* value_object, _Parse_state* parser_state) {
+        if (parser_state->inferred_signatures != NULL) {
+                return _parse_inferred_variant_value(value_object, parser_state);
+        }
+        // Outermost inferred variant owns the remembered signatures
+        parser_state->inferred_signatures = CALL_PYTHON_AND_CHECK(PyDict_New());
+        PyObject* parse_result = _parse_inferred_variant_value(value_object, parser_state);
+        Py_CLEAR(parser_state->inferred_signatures);
+        return parse_result;
+}
+
+static PyObject* _parse_variant(PyObject* tuple_object, _Parse_state* parser_state) {
+        // "...v..."
+        //     ^
+        if (!PyTuple_Check(tuple_object)) {
+                if (parser_state->flags & SD_BUS_PY_ENCODE_INFER_VARIANTS) {
+                        return _parse_inferred_variant(tuple_object, parser_state);
+                }
+                PyErr_Format(PyExc_TypeError, "Message append error, expected tuple got %R", tuple_object);
+                return NULL;
+        }
+        if (SD_BUS_PY_TUPLE_GET_SIZE(tuple_object) != 2) {
+                PyErr_Format(PyExc_TypeError, "Expected tuple of only 2 elements got %zi", SD_BUS_PY_TUPLE_GET_SIZE(tuple_object));
+                return NULL;
+        }
+        PyObject* variant_signature = SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, 0);
+        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(variant_signature));
+        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+        if (variant_plan->top_level_count != 1) {
+                PyErr_Format(PyExc_TypeError, "Variant signature must be a single complete type, got %R", variant_signature);
+                return NULL;
+        }
+
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'v', variant_plan->nodes[0].signature));
+        PyObject* variant_body = SD_BUS_PY_TUPLE_GET_ITEM(tuple_object, 1);
+        CALL_PYTHON_EXPECT_NONE(_parse_complete(variant_body, parser_state, &variant_plan->nodes[0]));
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
+
+        Py_RETURN_NONE;
+}
+
+static PyObject* _parse_encoded_value(SdBusEncodedValueObject* encoded_value, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        // Copies pre-encoded value without going through Python objects
+        if (encoded_value->message_ref == NULL) {
+                PyErr_SetString(PyExc_ValueError, "Encoded value is empty. Use SdBus.new_encoded_value to create one.");
+                return NULL;
+        }
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
+        const char* encoded_signature = SD_BUS_PY_UNICODE_AS_CHAR_PTR(encoded_value->signature);
+#else
+        PyObject* signature_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(encoded_value->signature);
+        const char* encoded_signature = SD_BUS_PY_BYTES_AS_CHAR_PTR(signature_bytes);
+#endif
+        int is_wrapped_in_variant = 0;
+        if (strcmp(encoded_signature, node->signature) != 0) {
+                if (node->type != 'v') {
+                        PyErr_Format(PyExc_TypeError, "Encoded value of signature \"%s\" can't be appended as \"%s\"", encoded_signature,
+                                     node->signature);
+                        return NULL;
+                }
+                is_wrapped_in_variant = 1;
+        }
+
+        if (is_wrapped_in_variant) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_open_container(parser_state->message, 'v', encoded_signature));
+        }
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_rewind(encoded_value->message_ref, 1));
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_copy(parser_state->message, encoded_value->message_ref, 1));
+        if (is_wrapped_in_variant) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_close_container(parser_state->message));
+        }
+
+        Py_RETURN_NONE;
+}
+
+static PyObject* _parse_complete(PyObject* complete_obj, _Parse_state* parser_state, const SdBusSignatureNode* node) {
+        if (node->contents != NULL || node->type == 'v') {
+                // Containers can be pre-encoded
+                if (Py_TYPE(complete_obj) == (PyTypeObject*)SdBusEncodedValue_class) {
+                        return _parse_encoded_value((SdBusEncodedValueObject*)complete_obj, parser_state, node);
+                }
+        }
+        switch (node->type) {
+                case 'r': {
+                        // Struct == Tuple
+                        CALL_PYTHON_EXPECT_NONE(_parse_struct(complete_obj, parser_state, node));
+                        break;
+                }
+                case 'a': {
+                        // Array
+                        CALL_PYTHON_EXPECT_NONE(_parse_array(complete_obj, parser_state, node));
+                        break;
+                }
+                case 'v': {
+                        // Variant == (signature, data))
+                        CALL_PYTHON_EXPECT_NONE(_parse_variant(complete_obj, parser_state));
+                        break;
+                }
+                default: {
+                        // Basic type
+                        CALL_PYTHON_EXPECT_NONE(_parse_basic(complete_obj, parser_state, node));
+                        break;
+                }
+        }
+        Py_RETURN_NONE;
+}
+
+#define _CHECK_PARSER_NOT_AT_END(node, nodes_end)                             \
+        if (node == nodes_end) {                                              \
+                PyErr_SetString(PyExc_TypeError, "Data signature too short"); \
+                return NULL;                                                  \
+        }
+
+static int _resolve_encode_flags(PyObject* signature_str, unsigned long* encode_flags) {
+        // Flags set by set_signature_encode_flags
+        *encode_flags = 0;
+        if (PyDict_Size(signature_encode_flags_dict) == 0) {
+                return 0;
+        }
+        PyObject* flags_object = PyDict_GetItemWithError(signature_encode_flags_dict, signature_str);
+        if (flags_object == NULL) {
+                return PyErr_Occurred() ? -1 : 0;
+        }
+        *encode_flags = PyLong_AsUnsignedLong(flags_object);
+        return PyErr_Occurred() ? -1 : 0;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_append_data(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        if (nargs < 2) {
+                PyErr_SetString(PyExc_TypeError, "Minimum 2 args required");
+                return NULL;
+        }
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(args[0]));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        const SdBusSignatureNode* node = plan->nodes;
+        const SdBusSignatureNode* nodes_end = plan->nodes + plan->nodes_count;
+
         _Parse_state parser_state = {
             .message = self->message_ref,
-            .container_char_ptr = signature_char_ptr,
-            .index = 0,
-            .max_index = strlen(signature_char_ptr),
         };
+        CALL_PYTHON_INT_CHECK(_resolve_encode_flags(args[0], &parser_state.flags));
 
         for (Py_ssize_t i = 1; i < nargs; ++i) {
-                CALL_PYTHON_EXPECT_NONE(_parse_complete(args[i], &parser_state));
+                _CHECK_PARSER_NOT_AT_END(node, nodes_end);
+                CALL_PYTHON_EXPECT_NONE(_parse_complete(args[i], &parser_state, node));
+                node += node->subtree_size;
         }
 #else
 static PyObject* SdBusMessage_append_data(SdBusMessageObject* self, PyObject* args) {
@@ -645,24 +1129,26 @@ static PyObject* SdBusMessage_append_data(SdBusMessageObject* self, PyObject* ar
                 return NULL;
         }
         PyObject* signature_str = PyTuple_GetItem(args, 0);
-        PyObject* signature_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(signature_str);
-        const char* signature_char_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(signature_bytes);
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        const SdBusSignatureNode* node = plan->nodes;
+        const SdBusSignatureNode* nodes_end = plan->nodes + plan->nodes_count;
 
         _Parse_state parser_state = {
             .message = self->message_ref,
-            .container_char_ptr = signature_char_ptr,
-            .index = 0,
-            .max_index = strlen(signature_char_ptr),
         };
+        CALL_PYTHON_INT_CHECK(_resolve_encode_flags(signature_str, &parser_state.flags));
 
         for (Py_ssize_t i = 1; i < num_args; ++i) {
-                CALL_PYTHON_EXPECT_NONE(_parse_complete(PyTuple_GetItem(args, i), &parser_state));
+                _CHECK_PARSER_NOT_AT_END(node, nodes_end);
+                CALL_PYTHON_EXPECT_NONE(_parse_complete(PyTuple_GetItem(args, i), &parser_state, node));
+                node += node->subtree_size;
         }
 #endif
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusMessage_open_container(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -687,7 +1173,7 @@ static PyObject* SdBusMessage_close_container(SdBusMessageObject* self, PyObject
         Py_RETURN_NONE;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusMessage_enter_container(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -701,12 +1187,15 @@ static PyObject* SdBusMessage_enter_container(SdBusMessageObject* self, PyObject
         const char* container_contents_char_ptr = NULL;
         CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "ss", &container_type_char_ptr, &container_contents_char_ptr, NULL));
 #endif
+        // Lazy views have to seek again after the read position moves
+        self->lazy_cursor_owner = NULL;
         CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(self->message_ref, container_type_char_ptr[0], container_contents_char_ptr));
 
         Py_RETURN_NONE;
 }
 
 static PyObject* SdBusMessage_exit_container(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
+        self->lazy_cursor_owner = NULL;
         CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(self->message_ref));
 
         Py_RETURN_NONE;
@@ -725,37 +1214,16 @@ static SdBusMessageObject* SdBusMessage_create_reply(SdBusMessageObject* self, P
 static PyObject* SdBusMessage_send(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
         CALL_SD_BUS_AND_CHECK(sd_bus_send(NULL, self->message_ref, NULL));
 
-        Py_RETURN_NONE;
-}
-
-static size_t _container_size(const char* container_sig) {
-        size_t container_size = 0;
-        size_t index = 0;
-
-        while ((container_sig[index]) != '\0') {
-                char current_char = container_sig[index];
-                index++;
-                if (current_char == 'a') {
-                        index = _find_array_end(container_sig, index);
-                        index++;
-                }
-
-                if (current_char == '(') {
-                        index = _find_struct_end(container_sig, index);
-                        index++;
-                }
-
-                if (index == 0) {
-                        PyErr_SetString(PyExc_TypeError, "Failed to find container size");
-                        return 0;
-                }
-
-                container_size++;
+        int events = sd_bus_get_events(sd_bus_message_get_bus(self->message_ref));
+        if (events > 0 && (events & POLLOUT)) {
+                // Socket is full. Flush the rest once it becomes writable.
+                CALL_PYTHON_INT_CHECK(_SdBus_wake_writer(sd_bus_message_get_bus(self->message_ref)));
         }
-        return container_size;
+
+        Py_RETURN_NONE;
 }
 
-static PyObject* _iter_complete(_Parse_state* parser);
+static PyObject* _iter_complete(_Parse_state* parser, const SdBusSignatureNode* node);
 
 static PyObject* _iter_basic(sd_bus_message* message, char basic_type) {
         switch (basic_type) {
@@ -825,7 +1293,7 @@ static PyObject* _iter_basic(sd_bus_message* message, char basic_type) {
                 case 's': {
                         const char* new_string = NULL;
                         CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(message, basic_type, &new_string));
-                        return PyUnicode_FromString(new_string);
+                        return _SdBusStringCache_get(new_string);
                         break;
                 }
                 default: {
@@ -843,22 +1311,147 @@ static PyObject* _iter_bytes_array(_Parse_state* parser) {
         const void* char_array = NULL;
         size_t array_size = 0;
         CALL_SD_BUS_AND_CHECK(sd_bus_message_read_array(parser->message, 'y', &char_array, &array_size));
+        SD_BUS_PY_DECODE_CHARGE(parser, 0, 0, array_size);
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+        if (parser->flags & SD_BUS_PY_DECODE_MEMORY_VIEW) {
+                // Memory view of the message memory. Buffer object keeps the message alive.
+                PyObject* new_buffer_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessageBuffer_class));
+                SdBusMessageBufferObject* new_buffer = (SdBusMessageBufferObject*)new_buffer_object;
+                new_buffer->message_ref = sd_bus_message_ref(parser->message);
+                new_buffer->array_ptr = array_size > 0 ? char_array : "";
+                new_buffer->array_size = array_size;
+                return PyMemoryView_FromObject(new_buffer_object);
+        }
+#endif
         return PyBytes_FromStringAndSize(char_array, (Py_ssize_t)array_size);
 }
 
-static PyObject* _iter_dict(_Parse_state* parser) {
-        PyObject* new_dict CLEANUP_PY_OBJECT = PyDict_New();
-
-        char peek_type = '\0';
-        const char* container_type = NULL;
-        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(parser->message, &peek_type, &container_type)) > 0) {
-                if (peek_type != SD_BUS_TYPE_DICT_ENTRY) {
-                        PyErr_SetString(PyExc_TypeError, "Expected dict entry.");
+static const char* _typed_array_typecode(char element_type) {
+        // Item sizes of these typecodes match dbus types on all Linux platforms
+        switch (element_type) {
+                case 'n':
+                        return "h";
+                case 'q':
+                        return "H";
+                case 'i':
+                        return "i";
+                case 'u':
+                        return "I";
+                case 'x':
+                        return "q";
+                case 't':
+                        return "Q";
+                case 'd':
+                        return "d";
+                default:
                         return NULL;
+        }
+}
+
+static int _read_swapped_array(sd_bus_message* message, char element_type, void** array_ptr, size_t* array_size) {
+        // sd-bus only exposes array memory of the messages with native byte order.
+        // Others are read element by element which lets sd-bus swap the bytes.
+        char element_type_str[2] = {element_type, '\0'};
+        size_t element_size = _fixed_width_type_size(element_type);
+        size_t allocated_size = 0;
+        size_t used_size = 0;
+        uint8_t* new_array = NULL;
+
+        int return_value = sd_bus_message_enter_container(message, 'a', element_type_str);
+        while (return_value >= 0) {
+                return_value = sd_bus_message_at_end(message, 0);
+                if (return_value != 0) {
+                        break;
                 }
-                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, peek_type, container_type));
-                PyObject* key_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_basic(parser->message, container_type[0]));
-                PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser));
+                if (used_size == allocated_size) {
+                        allocated_size = allocated_size == 0 ? 64 * element_size : allocated_size * 2;
+                        uint8_t* resized_array = PyMem_Realloc(new_array, allocated_size);
+                        if (resized_array == NULL) {
+                                PyMem_Free(new_array);
+                                return -ENOMEM;
+                        }
+                        new_array = resized_array;
+                }
+                return_value = sd_bus_message_read_basic(message, element_type, new_array + used_size);
+                used_size += element_size;
+        }
+        if (return_value >= 0) {
+                return_value = sd_bus_message_exit_container(message);
+        }
+        if (return_value < 0) {
+                PyMem_Free(new_array);
+                return return_value;
+        }
+        *array_ptr = new_array;
+        *array_size = used_size;
+        return 0;
+}
+
+static PyObject* _typed_array_from_memory(const char* typecode, const void* array_ptr, size_t array_size) {
+        PyObject* new_array CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallFunction(array_array_class, "s", typecode));
+        if (array_size > 0) {
+                PyObject* array_memory_view CLEANUP_PY_OBJECT =
+                    CALL_PYTHON_AND_CHECK(PyMemoryView_FromMemory((char*)array_ptr, (Py_ssize_t)array_size, PyBUF_READ));
+                CALL_PYTHON_EXPECT_NONE(PyObject_CallMethodObjArgs(new_array, frombytes_str, array_memory_view, NULL));
+        }
+
+        Py_INCREF(new_array);
+        return new_array;
+}
+
+static PyObject* _iter_typed_array(_Parse_state* parser, char element_type) {
+        // Fixed size elements are copied in to array.array with a single memcpy
+        // instead of creating a Python object for each element.
+        const void* array_ptr = NULL;
+        void* swapped_array_ptr CLEANUP_PYMEM_PTR = NULL;
+        size_t array_size = 0;
+        int return_value = sd_bus_message_read_array(parser->message, element_type, &array_ptr, &array_size);
+        if (return_value == -EOPNOTSUPP) {
+                CALL_SD_BUS_AND_CHECK(_read_swapped_array(parser->message, element_type, &swapped_array_ptr, &array_size));
+                array_ptr = swapped_array_ptr;
+        } else {
+                CALL_SD_BUS_AND_CHECK(return_value);
+        }
+        SD_BUS_PY_DECODE_CHARGE(parser, 0, array_size / _fixed_width_type_size(element_type), 0);
+        return _typed_array_from_memory(_typed_array_typecode(element_type), array_ptr, array_size);
+}
+
+static PyObject* _iter_memfd(_Parse_state* parser) {
+        // Sealed memfd can't be modified by the sender after it was
+        // received so it can be safely mapped instead of being read.
+        int unix_fd = -1;
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, 'h', &unix_fd));
+
+        // Mapping of a file that can still shrink or change is unsafe
+        int seals = fcntl(unix_fd, F_GET_SEALS);
+        if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE)) {
+                PyErr_Format(PyExc_TypeError, "File descriptor %d is not a memfd sealed against writing and shrinking", unix_fd);
+                return NULL;
+        }
+
+        struct stat memfd_stat = {0};
+        if (fstat(unix_fd, &memfd_stat) < 0) {
+                return PyErr_SetFromErrno(PyExc_OSError);
+        }
+        if (memfd_stat.st_size == 0) {
+                return PyMemoryView_FromMemory("", 0, PyBUF_READ);
+        }
+        // mmap object duplicates the fd
+        PyObject* new_mmap CLEANUP_PY_OBJECT =
+            CALL_PYTHON_AND_CHECK(PyObject_CallFunction(mmap_class, "inii", unix_fd, (Py_ssize_t)memfd_stat.st_size, MAP_SHARED, PROT_READ));
+        return PyMemoryView_FromObject(new_mmap);
+}
+
+static PyObject* _iter_dict(_Parse_state* parser, const SdBusSignatureNode* dict_node) {
+        PyObject* new_dict CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyDict_New());
+        const SdBusSignatureNode* key_node = dict_node + 1;
+        const SdBusSignatureNode* value_node = key_node + key_node->subtree_size;
+
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(parser->message, 0)) == 0) {
+                SD_BUS_PY_DECODE_CHARGE(parser, 1, 1, 0);
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'e', dict_node->contents));
+                PyObject* key_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_basic(parser->message, key_node->type));
+                PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser, value_node));
                 CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
                 if (PyDict_SetItem(new_dict, key_object, value_object) < 0) {
                         return NULL;
@@ -869,13 +1462,12 @@ static PyObject* _iter_dict(_Parse_state* parser) {
         return new_dict;
 }
 
-static PyObject* _iter_array(_Parse_state* parser) {
+static PyObject* _iter_array(_Parse_state* parser, const SdBusSignatureNode* element_node) {
         PyObject* new_list CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyList_New(0));
-        char peek_type = '\0';
-        const char* container_type = NULL;
 
-        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(parser->message, &peek_type, &container_type)) > 0) {
-                PyObject* new_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser));
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(parser->message, 0)) == 0) {
+                SD_BUS_PY_DECODE_CHARGE(parser, 0, 1, 0);
+                PyObject* new_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser, element_node));
                 if (PyList_Append(new_list, new_object) < 0) {
                         return NULL;
                 }
@@ -884,127 +1476,1013 @@ static PyObject* _iter_array(_Parse_state* parser) {
         return new_list;
 }
 
-static PyObject* _iter_struct(_Parse_state* parser) {
-        const char* container_sig = sd_bus_message_get_signature(parser->message, 0);
-        if (container_sig == NULL) {
-                PyErr_SetString(PyExc_TypeError, "Failed to get container signature");
-                return NULL;
+static int _is_string_type(char type_char) {
+        return type_char == 's' || type_char == 'o' || type_char == 'g';
+}
+
+static PyObject* _iter_string_array(_Parse_state* parser, char element_type) {
+        // "as", "ao", "ag"
+        // Reading past the last element returns 0 so
+        // there is no need to check for the array end.
+        PyObject* new_list CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyList_New(0));
+        const char* new_string = NULL;
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, element_type, &new_string)) > 0) {
+                SD_BUS_PY_DECODE_CHARGE(parser, 1, 1, strlen(new_string));
+                PyObject* new_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(new_string));
+                CALL_PYTHON_INT_CHECK(PyList_Append(new_list, new_str));
         }
-        size_t tuple_size = _container_size(container_sig);
+        Py_INCREF(new_list);
+        return new_list;
+}
 
-        if (tuple_size == 0) {
-                return NULL;
+static PyObject* _iter_string_key_dict(_Parse_state* parser, const SdBusSignatureNode* dict_node) {
+        // "a{ss}", "a{su}", "a{sv}", "a{oa{sv}}"...
+        // Entering past the last entry returns 0.
+        PyObject* new_dict CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyDict_New());
+        const SdBusSignatureNode* key_node = dict_node + 1;
+        const SdBusSignatureNode* value_node = key_node + 1;
+        const char* key_string = NULL;
+
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'e', dict_node->contents)) > 0) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, key_node->type, &key_string));
+                SD_BUS_PY_DECODE_CHARGE(parser, 1, 1, strlen(key_string));
+                PyObject* key_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(key_string));
+                PyObject* value_object CLEANUP_PY_OBJECT = NULL;
+                if (_is_string_type(value_node->type)) {
+                        const char* value_string = NULL;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, value_node->type, &value_string));
+                        SD_BUS_PY_DECODE_CHARGE(parser, 1, 0, strlen(value_string));
+                        value_object = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(value_string));
+                } else {
+                        value_object = CALL_PYTHON_AND_CHECK(_iter_complete(parser, value_node));
+                }
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                CALL_PYTHON_INT_CHECK(PyDict_SetItem(new_dict, key_object, value_object));
         }
 
-        PyObject* new_tuple CLEANUP_PY_OBJECT = PyTuple_New((Py_ssize_t)tuple_size);
+        Py_INCREF(new_dict);
+        return new_dict;
+}
+
+static PyObject* _iter_struct(_Parse_state* parser, const SdBusSignatureNode* first_field_node, size_t tuple_size) {
+        PyObject* new_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyTuple_New((Py_ssize_t)tuple_size));
+        const SdBusSignatureNode* field_node = first_field_node;
         for (size_t i = 0; i < tuple_size; ++i) {
-                PyObject* new_complete = CALL_PYTHON_AND_CHECK(_iter_complete(parser));
+                PyObject* new_complete = CALL_PYTHON_AND_CHECK(_iter_complete(parser, field_node));
                 SD_BUS_PY_TUPLE_SET_ITEM(new_tuple, i, new_complete);
+                field_node += field_node->subtree_size;
+        }
+        Py_INCREF(new_tuple);
+        return new_tuple;
+}
+
+static PyObject* _struct_type_new(PyObject* struct_type, PyObject* fields_tuple, size_t fields_count) {
+        // Builds the instance of registered struct type from decoded fields
+        if (PyType_Check(struct_type) && PyType_IsSubtype((PyTypeObject*)struct_type, &PyTuple_Type)) {
+                PyObject* struct_fields = CALL_PYTHON_AND_CHECK(_SdBusStructType_get_fields(struct_type));
+                if (struct_fields != Py_None && (size_t)SD_BUS_PY_TUPLE_GET_SIZE(struct_fields) == fields_count) {
+                        return PyObject_CallFunctionObjArgs(tuple_new_func, struct_type, fields_tuple, NULL);
+                }
+        }
+        return PyObject_Call(struct_type, fields_tuple, NULL);
+}
+
+static PyObject* _iter_struct_as_type(_Parse_state* parser, const SdBusSignatureNode* node, PyObject* struct_type) {
+        // Builds the instance of registered struct type.
+        // Message should be inside the struct container.
+#ifndef Py_LIMITED_API
+        if (PyType_Check(struct_type) && PyType_IsSubtype((PyTypeObject*)struct_type, &PyTuple_Type)) {
+                // NamedTuple slots are filled directly without calling its __new__
+                PyObject* struct_fields = CALL_PYTHON_AND_CHECK(_SdBusStructType_get_fields(struct_type));
+                if (struct_fields != Py_None && (size_t)PyTuple_GET_SIZE(struct_fields) == node->children_count) {
+                        PyTypeObject* named_tuple_type = (PyTypeObject*)struct_type;
+                        PyObject* new_named_tuple CLEANUP_PY_OBJECT =
+                            CALL_PYTHON_AND_CHECK(named_tuple_type->tp_alloc(named_tuple_type, (Py_ssize_t)node->children_count));
+                        const SdBusSignatureNode* field_node = node + 1;
+                        for (size_t i = 0; i < node->children_count; ++i) {
+                                PyObject* new_complete = CALL_PYTHON_AND_CHECK(_iter_complete(parser, field_node));
+                                PyTuple_SET_ITEM(new_named_tuple, i, new_complete);
+                                field_node += field_node->subtree_size;
+                        }
+                        Py_INCREF(new_named_tuple);
+                        return new_named_tuple;
+                }
+        }
+#endif
+        PyObject* fields_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_struct(parser, node + 1, node->children_count));
+        return _struct_type_new(struct_type, fields_tuple, node->children_count);
+}
+
+static int _iter_struct_lookup_type(_Parse_state* parser, const SdBusSignatureNode* node, PyObject** struct_type) {
+        // Borrowed type registered for the struct signature or NULL
+        *struct_type = NULL;
+        if (parser->struct_types == NULL && PyDict_Size(struct_types_dict) == 0) {
+                return 0;
+        }
+        PyObject* signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_CHECK_RETURN_NEG1(_SdBusStringCache_get(node->signature));
+        // Types passed to the call take priority over registered ones
+        if (parser->struct_types != NULL) {
+                *struct_type = PyDict_GetItemWithError(parser->struct_types, signature_str);
+                if (*struct_type != NULL) {
+                        return 0;
+                }
+                if (PyErr_Occurred()) {
+                        return -1;
+                }
+        }
+        *struct_type = PyDict_GetItemWithError(struct_types_dict, signature_str);
+        if (*struct_type == NULL && PyErr_Occurred()) {
+                return -1;
+        }
+        return 0;
+}
+
+// Columns
+//
+// Arrays of structs with only basic fields such as "a(sou)" are decoded
+// in to a tuple of columns instead of a list of rows. Fixed size number
+// columns are collected in to a single buffer each and become array.array.
+// Other columns are lists and strings come from the string cache so
+// the repeating values share a single object.
+
+typedef struct {
+        uint8_t* data;    // Numbers column
+        size_t used_size;
+        size_t allocated_size;
+        PyObject* list;    // Strings, booleans and unix fds column
+} _Struct_column;
+
+static int _struct_is_columnar(const SdBusSignatureNode* struct_node) {
+        // Basic fields have no children so the subtree is the struct and its fields
+        if (struct_node->type != 'r' || struct_node->subtree_size != struct_node->children_count + 1) {
+                return 0;
+        }
+        for (size_t i = 1; i <= struct_node->children_count; ++i) {
+                if (struct_node[i].type == 'v') {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+static const char* _column_typecode(char field_type) {
+        if (field_type == 'y') {
+                return "B";
+        }
+        return _typed_array_typecode(field_type);
+}
+
+static int _column_append_number(sd_bus_message* message, _Struct_column* column, char field_type) {
+        size_t field_size = _fixed_width_type_size(field_type);
+        if (column->used_size + field_size > column->allocated_size) {
+                size_t new_size = column->allocated_size == 0 ? 64 * field_size : column->allocated_size * 2;
+                uint8_t* resized_data = PyMem_Realloc(column->data, new_size);
+                if (resized_data == NULL) {
+                        PyErr_NoMemory();
+                        return -1;
+                }
+                column->data = resized_data;
+                column->allocated_size = new_size;
+        }
+        CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_read_basic(message, field_type, column->data + column->used_size));
+        column->used_size += field_size;
+        return 0;
+}
+
+static PyObject* _iter_struct_columns_read(_Parse_state* parser, const SdBusSignatureNode* struct_node, _Struct_column* columns) {
+        const SdBusSignatureNode* field_nodes = struct_node + 1;
+        size_t columns_count = struct_node->children_count;
+        for (size_t i = 0; i < columns_count; ++i) {
+                if (_column_typecode(field_nodes[i].type) == NULL) {
+                        columns[i].list = CALL_PYTHON_AND_CHECK(PyList_New(0));
+                }
+        }
+
+        // Entering past the last struct returns 0.
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'r', struct_node->contents)) > 0) {
+                SD_BUS_PY_DECODE_CHARGE(parser, 0, 1, 0);
+                for (size_t i = 0; i < columns_count; ++i) {
+                        char field_type = field_nodes[i].type;
+                        if (columns[i].list == NULL) {
+                                CALL_PYTHON_INT_CHECK(_column_append_number(parser->message, &columns[i], field_type));
+                                continue;
+                        }
+                        PyObject* new_object CLEANUP_PY_OBJECT = NULL;
+                        if (_is_string_type(field_type)) {
+                                const char* new_string = NULL;
+                                CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, field_type, &new_string));
+                                SD_BUS_PY_DECODE_CHARGE(parser, 1, 0, strlen(new_string));
+                                new_object = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(new_string));
+                        } else {
+                                SD_BUS_PY_DECODE_CHARGE(parser, 1, 0, 0);
+                                new_object = CALL_PYTHON_AND_CHECK(_iter_basic(parser->message, field_type));
+                        }
+                        CALL_PYTHON_INT_CHECK(PyList_Append(columns[i].list, new_object));
+                }
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+        }
+
+        PyObject* new_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyTuple_New((Py_ssize_t)columns_count));
+        for (size_t i = 0; i < columns_count; ++i) {
+                PyObject* new_column = NULL;
+                if (columns[i].list != NULL) {
+                        Py_INCREF(columns[i].list);
+                        new_column = columns[i].list;
+                } else {
+                        new_column = CALL_PYTHON_AND_CHECK(
+                            _typed_array_from_memory(_column_typecode(field_nodes[i].type), columns[i].data, columns[i].used_size));
+                }
+                SD_BUS_PY_TUPLE_SET_ITEM(new_tuple, i, new_column);
         }
         Py_INCREF(new_tuple);
         return new_tuple;
 }
 
-static PyObject* _iter_variant(_Parse_state* parser) {
-        const char* container_sig = sd_bus_message_get_signature(parser->message, 0);
-        PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser));
-        PyObject* variant_sig_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(container_sig));
+static PyObject* _iter_struct_columns(_Parse_state* parser, const SdBusSignatureNode* struct_node) {
+        // Message should be inside the array container.
+        _Struct_column* columns = PyMem_Calloc(struct_node->children_count, sizeof(_Struct_column));
+        if (columns == NULL) {
+                return PyErr_NoMemory();
+        }
+        PyObject* new_columns = _iter_struct_columns_read(parser, struct_node, columns);
+        for (size_t i = 0; i < struct_node->children_count; ++i) {
+                PyMem_Free(columns[i].data);
+                Py_XDECREF(columns[i].list);
+        }
+        PyMem_Free(columns);
+        return new_columns;
+}
+
+static PyObject* _iter_variant(_Parse_state* parser, const char* container_sig) {
+        PyObject* variant_sig_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(container_sig));
+        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(variant_sig_str));
+        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+        if (parser->flags & SD_BUS_PY_DECODE_UNWRAP_VARIANTS) {
+                // Only the outermost variants are unwrapped so that
+                // the variant value decodes the same way as without the flag.
+                parser->flags &= ~SD_BUS_PY_DECODE_UNWRAP_VARIANTS;
+                PyObject* value_object = _iter_complete(parser, &variant_plan->nodes[0]);
+                parser->flags |= SD_BUS_PY_DECODE_UNWRAP_VARIANTS;
+                return value_object;
+        }
+        PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(parser, &variant_plan->nodes[0]));
         return PyTuple_Pack(2, variant_sig_str, value_object);
 }
 
-static PyObject* _iter_complete(_Parse_state* parser) {
-        const char* container_signature = NULL;
-        char complete_type = '\0';
-        // TODO: can be optimized with custom parser instead of constantly
-        // peeking
-        CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(parser->message, &complete_type, &container_signature));
-        switch (complete_type) {
+static PyObject* _iter_complete_node(_Parse_state* parser, const SdBusSignatureNode* node) {
+        switch (node->type) {
                 case 'a': {
-                        if (strcmp(container_signature, "y") == 0) {
+                        const SdBusSignatureNode* element_node = node + 1;
+                        if (element_node->type == 'y') {
                                 return _iter_bytes_array(parser);
                         }
+                        if ((parser->flags & SD_BUS_PY_DECODE_TYPED_ARRAYS) && _typed_array_typecode(element_node->type) != NULL) {
+                                return _iter_typed_array(parser, element_node->type);
+                        }
 
-                        if (container_signature[0] == '{') {
-                                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, complete_type, container_signature));
-                                PyObject* new_dict = CALL_PYTHON_AND_CHECK(_iter_dict(parser));
-                                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
-                                return new_dict;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'a', node->contents));
+                        PyObject* new_array CLEANUP_PY_OBJECT = NULL;
+                        if (_is_string_type(element_node->type)) {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_string_array(parser, element_node->type));
+                        } else if (element_node->type == 'e' && _is_string_type((element_node + 1)->type)) {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_string_key_dict(parser, element_node));
+                        } else if (element_node->type == 'e') {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_dict(parser, element_node));
+                        } else if ((parser->flags & SD_BUS_PY_DECODE_COLUMNS) && _struct_is_columnar(element_node)) {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_struct_columns(parser, element_node));
+                        } else {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_array(parser, element_node));
                         }
-                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, complete_type, container_signature));
-                        PyObject* new_array = CALL_PYTHON_AND_CHECK(_iter_array(parser));
                         CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        Py_INCREF(new_array);
                         return new_array;
                         break;
                 }
                 case 'v': {
-                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, complete_type, container_signature));
-                        PyObject* new_variant = CALL_PYTHON_AND_CHECK(_iter_variant(parser));
+                        const char* container_signature = NULL;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(parser->message, NULL, &container_signature));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'v', container_signature));
+                        PyObject* new_variant CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_variant(parser, container_signature));
                         CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        Py_INCREF(new_variant);
                         return new_variant;
                         break;
                 }
                 case 'r': {
-                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, complete_type, container_signature));
-                        PyObject* new_tuple = CALL_PYTHON_AND_CHECK(_iter_struct(parser));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'r', node->contents));
+                        PyObject* struct_type = NULL;
+                        CALL_PYTHON_INT_CHECK(_iter_struct_lookup_type(parser, node, &struct_type));
+                        PyObject* new_tuple CLEANUP_PY_OBJECT =
+                            struct_type != NULL ? CALL_PYTHON_AND_CHECK(_iter_struct_as_type(parser, node, struct_type))
+                                                : CALL_PYTHON_AND_CHECK(_iter_struct(parser, node + 1, node->children_count));
                         CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        Py_INCREF(new_tuple);
                         return new_tuple;
                         break;
                 }
+                case 'h': {
+                        if (parser->flags & SD_BUS_PY_DECODE_MEMFD) {
+                                return _iter_memfd(parser);
+                        }
+                        return _iter_basic(parser->message, node->type);
+                        break;
+                }
                 default: {
-                        return _iter_basic(parser->message, complete_type);
+                        return _iter_basic(parser->message, node->type);
                         break;
                 }
         }
 }
 
-static PyObject* iter_tuple_or_single(_Parse_state* parser) {
-        // Calculate the length of message data
-        size_t container_size = _container_size(parser->container_char_ptr);
-        if (container_size == 0) {
-                return NULL;
+static PyObject* _iter_complete(_Parse_state* parser, const SdBusSignatureNode* node) {
+        if (parser->limits == NULL) {
+                return _iter_complete_node(parser, node);
         }
-
-        if (container_size == 1) {
-                return _iter_complete(parser);
-        } else {
-                return _iter_struct(parser);
+        // Every complete type becomes a Python object
+        SD_BUS_PY_DECODE_CHARGE(parser, 1, 0, 0);
+        if (_is_string_type(node->type)) {
+                const char* new_string = NULL;
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, node->type, &new_string));
+                SD_BUS_PY_DECODE_CHARGE(parser, 0, 0, strlen(new_string));
+                return _SdBusStringCache_get(new_string);
+        }
+        if (node->type != 'a' && node->type != 'r' && node->type != 'v') {
+                return _iter_complete_node(parser, node);
         }
+        CALL_PYTHON_INT_CHECK(_decode_budget_check_depth(parser));
+        parser->depth++;
+        PyObject* new_object = _iter_complete_node(parser, node);
+        parser->depth--;
+        return new_object;
 }
 
-static PyObject* SdBusMessage_get_contents2(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
-        const char* message_signature = sd_bus_message_get_signature(self->message_ref, 0);
-
-        if (message_signature == NULL) {
-                PyErr_SetString(PyExc_TypeError, "Failed to get message signature.");
-                return NULL;
+// Projections
+//
+// Projection selects parts of the value to decode. Everything else
+// is skipped without creating Python objects.
+//
+// None decodes the whole value.
+// Dict maps the selected dict keys or struct field indexes to the
+// projections of their values. Set, list or tuple select the keys or
+// indexes to be decoded whole. Array and variant projections apply to
+// their elements and contents. Skipped struct fields are decoded as None.
+// Structs with every field selected are decoded as their struct type,
+// partially selected ones are always tuples.
+
+static int _projection_lookup(PyObject* projection, PyObject* key, PyObject** sub_projection) {
+        // Returns 1 if key is selected, 0 if not and -1 on error
+        if (PyDict_Check(projection)) {
+                *sub_projection = PyDict_GetItemWithError(projection, key);
+                if (*sub_projection == NULL) {
+                        return PyErr_Occurred() ? -1 : 0;
+                }
+                return 1;
         }
-        if (message_signature[0] == '\0') {
-                // Empty message
-                Py_RETURN_NONE;
+        *sub_projection = Py_None;
+        if (PyAnySet_Check(projection)) {
+                return PySet_Contains(projection, key);
         }
-
-        _Parse_state read_parser = {
-            .message = self->message_ref,
-            .container_char_ptr = message_signature,
-            .index = 0,
-            .max_index = strlen(message_signature),
-        };
-        /* Parsing strategy
-       Either return a single object (single string, single int, single array)
-       or a tuple of single objects. This mirrors the python function returns.
-      */
-        return iter_tuple_or_single(&read_parser);
+        if (PyList_Check(projection) || PyTuple_Check(projection)) {
+                return PySequence_Contains(projection, key);
+        }
+        PyErr_Format(PyExc_TypeError, "Projection must be None, dict, set, list or tuple, got %R", projection);
+        return -1;
 }
 
-static SdBusCredsObject* SdBusMessage_get_creds(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
-        SdBusCredsObject* new_creds_object CLEANUP_SD_BUS_CREDS =
-            (SdBusCredsObject*)CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(SdBusCreds_class, NULL));
-        _SdBusCreds_set_creds_from_message(new_creds_object, self->message_ref);
+static PyObject* _iter_projected(_Parse_state* parser, const SdBusSignatureNode* node, PyObject* projection);
+
+static PyObject* _iter_struct_projected(_Parse_state* parser,
+                                        const SdBusSignatureNode* first_field_node,
+                                        size_t tuple_size,
+                                        PyObject* projection,
+                                        size_t* selected_count) {
+        PyObject* new_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyTuple_New((Py_ssize_t)tuple_size));
+        const SdBusSignatureNode* field_node = first_field_node;
+        for (size_t i = 0; i < tuple_size; ++i) {
+                PyObject* field_index CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyLong_FromSize_t(i));
+                PyObject* sub_projection = NULL;
+                PyObject* new_complete = NULL;
+                if (CALL_PYTHON_INT_CHECK(_projection_lookup(projection, field_index, &sub_projection))) {
+                        new_complete = CALL_PYTHON_AND_CHECK(_iter_projected(parser, field_node, sub_projection));
+                        (*selected_count)++;
+                } else {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(parser->message, field_node->signature));
+                        Py_INCREF(Py_None);
+                        new_complete = Py_None;
+                }
+                SD_BUS_PY_TUPLE_SET_ITEM(new_tuple, i, new_complete);
+                field_node += field_node->subtree_size;
+        }
+        Py_INCREF(new_tuple);
+        return new_tuple;
+}
+
+static PyObject* _iter_dict_projected(_Parse_state* parser, const SdBusSignatureNode* dict_node, PyObject* projection) {
+        PyObject* new_dict CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyDict_New());
+        const SdBusSignatureNode* key_node = dict_node + 1;
+        const SdBusSignatureNode* value_node = key_node + key_node->subtree_size;
+
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(parser->message, 0)) == 0) {
+                SD_BUS_PY_DECODE_CHARGE(parser, 1, 1, 0);
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'e', dict_node->contents));
+                PyObject* key_object CLEANUP_PY_OBJECT = NULL;
+                if (_is_string_type(key_node->type)) {
+                        const char* key_string = NULL;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_read_basic(parser->message, key_node->type, &key_string));
+                        SD_BUS_PY_DECODE_CHARGE(parser, 0, 0, strlen(key_string));
+                        key_object = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(key_string));
+                } else {
+                        key_object = CALL_PYTHON_AND_CHECK(_iter_basic(parser->message, key_node->type));
+                }
+                PyObject* sub_projection = NULL;
+                if (CALL_PYTHON_INT_CHECK(_projection_lookup(projection, key_object, &sub_projection))) {
+                        PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_projected(parser, value_node, sub_projection));
+                        CALL_PYTHON_INT_CHECK(PyDict_SetItem(new_dict, key_object, value_object));
+                } else {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(parser->message, value_node->signature));
+                }
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+        }
+
+        Py_INCREF(new_dict);
+        return new_dict;
+}
+
+static PyObject* _iter_projected_container(_Parse_state* parser, const SdBusSignatureNode* node, PyObject* projection) {
+        switch (node->type) {
+                case 'a': {
+                        const SdBusSignatureNode* element_node = node + 1;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'a', node->contents));
+                        PyObject* new_array CLEANUP_PY_OBJECT = NULL;
+                        if (element_node->type == 'e') {
+                                new_array = CALL_PYTHON_AND_CHECK(_iter_dict_projected(parser, element_node, projection));
+                        } else {
+                                new_array = CALL_PYTHON_AND_CHECK(PyList_New(0));
+                                while (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(parser->message, 0)) == 0) {
+                                        SD_BUS_PY_DECODE_CHARGE(parser, 0, 1, 0);
+                                        PyObject* new_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_projected(parser, element_node, projection));
+                                        CALL_PYTHON_INT_CHECK(PyList_Append(new_array, new_object));
+                                }
+                        }
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        Py_INCREF(new_array);
+                        return new_array;
+                }
+                case 'v': {
+                        const char* container_signature = NULL;
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(parser->message, NULL, &container_signature));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'v', container_signature));
+                        PyObject* variant_sig_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusStringCache_get(container_signature));
+                        PyObject* variant_plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(variant_sig_str));
+                        const SdBusSignaturePlan* variant_plan = _SdBusSignaturePlan_from_capsule(variant_plan_capsule);
+                        // Same as _iter_variant only the outermost variants are unwrapped
+                        unsigned long unwrap_flag = parser->flags & SD_BUS_PY_DECODE_UNWRAP_VARIANTS;
+                        parser->flags &= ~SD_BUS_PY_DECODE_UNWRAP_VARIANTS;
+                        PyObject* value_object CLEANUP_PY_OBJECT = _iter_projected(parser, &variant_plan->nodes[0], projection);
+                        parser->flags |= unwrap_flag;
+                        if (value_object == NULL) {
+                                return NULL;
+                        }
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        if (unwrap_flag) {
+                                Py_INCREF(value_object);
+                                return value_object;
+                        }
+                        return PyTuple_Pack(2, variant_sig_str, value_object);
+                }
+                case 'r': {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(parser->message, 'r', node->contents));
+                        size_t selected_count = 0;
+                        PyObject* new_tuple CLEANUP_PY_OBJECT =
+                            CALL_PYTHON_AND_CHECK(_iter_struct_projected(parser, node + 1, node->children_count, projection, &selected_count));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(parser->message));
+                        PyObject* struct_type = NULL;
+                        if (selected_count == node->children_count) {
+                                CALL_PYTHON_INT_CHECK(_iter_struct_lookup_type(parser, node, &struct_type));
+                        }
+                        if (struct_type != NULL) {
+                                return _struct_type_new(struct_type, new_tuple, node->children_count);
+                        }
+                        Py_INCREF(new_tuple);
+                        return new_tuple;
+                }
+                default: {
+                        return _iter_complete(parser, node);
+                }
+        }
+}
+
+static PyObject* _iter_projected(_Parse_state* parser, const SdBusSignatureNode* node, PyObject* projection) {
+        if (projection == Py_None || (node->type != 'a' && node->type != 'r' && node->type != 'v') ||
+            (node->type == 'a' && _fixed_width_type_size((node + 1)->type) != 0)) {
+                // Nothing to select in basic types and arrays of numbers
+                return _iter_complete(parser, node);
+        }
+        if (parser->limits == NULL) {
+                return _iter_projected_container(parser, node, projection);
+        }
+        // Projected containers are charged the same way as in _iter_complete
+        SD_BUS_PY_DECODE_CHARGE(parser, 1, 0, 0);
+        CALL_PYTHON_INT_CHECK(_decode_budget_check_depth(parser));
+        parser->depth++;
+        PyObject* new_object = _iter_projected_container(parser, node, projection);
+        parser->depth--;
+        return new_object;
+}
+
+// Lazy views
+//
+// Views remember the path from the message start to their array as
+// the indexes of the parent elements. Every access rewinds the message and
+// walks that path unless the message is already positioned in the view
+// at or before the requested element, which makes sequential access linear.
+
+static int _lazy_node_is_view(const SdBusSignatureNode* node, unsigned long flags) {
+        // Arrays of fixed size elements and columns are cheap to decode at once
+        if ((flags & SD_BUS_PY_DECODE_COLUMNS) && node->type == 'a' && _struct_is_columnar(node + 1)) {
+                return 0;
+        }
+        return node->type == 'a' && _fixed_width_type_size((node + 1)->type) == 0;
+}
+
+static int _lazy_view_charge(_Parse_state* parser) {
+        // Views are charged like the arrays they stand for
+        if (parser->limits == NULL) {
+                return 0;
+        }
+        if (_decode_budget_charge(parser, 1, 0, 0) < 0) {
+                return -1;
+        }
+        return _decode_budget_check_depth(parser);
+}
+
+static PyObject* _lazy_view_new(SdBusMessageObject* message_object,
+                                PyObject* plan_capsule,
+                                unsigned long flags,
+                                const SdBusLazyPathStep* parent_path,
+                                size_t parent_depth,
+                                const SdBusSignatureNode* array_node,
+                                Py_ssize_t index) {
+        PyObject* view_class = (array_node + 1)->type == 'e' ? SdBusLazyMapping_class : SdBusLazySequence_class;
+        PyObject* new_view_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(view_class));
+        SdBusLazyViewObject* new_view = (SdBusLazyViewObject*)new_view_object;
+
+        new_view->path = PyMem_Malloc(sizeof(SdBusLazyPathStep) * (parent_depth + 1));
+        if (new_view->path == NULL) {
+                return PyErr_NoMemory();
+        }
+        if (parent_depth > 0) {
+                memcpy(new_view->path, parent_path, sizeof(SdBusLazyPathStep) * parent_depth);
+        }
+        new_view->path[parent_depth] = (SdBusLazyPathStep){.node = array_node, .index = index};
+        new_view->path_depth = parent_depth + 1;
+
+        Py_INCREF(message_object);
+        new_view->message = message_object;
+        Py_INCREF(plan_capsule);
+        new_view->plan_capsule = plan_capsule;
+        new_view->flags = flags;
+        new_view->elements_count = -1;
+
+        Py_INCREF(new_view_object);
+        return new_view_object;
+}
+
+static PyObject* _lazy_view_enter(SdBusLazyViewObject* self) {
+        // Positions the message at the first element of the view
+        sd_bus_message* message = self->message->message_ref;
+        self->message->lazy_cursor_owner = NULL;
+
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_rewind(message, 1));
+        for (Py_ssize_t i = 0; i < self->path[0].index; ++i) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+        }
+        for (size_t depth = 0; depth < self->path_depth; ++depth) {
+                const SdBusSignatureNode* array_node = self->path[depth].node;
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(message, 'a', array_node->contents));
+                if (depth + 1 == self->path_depth) {
+                        break;
+                }
+                for (Py_ssize_t i = 0; i < self->path[depth + 1].index; ++i) {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+                }
+                if ((array_node + 1)->type == 'e') {
+                        // Child is the value of the dict entry
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(message, 'e', (array_node + 1)->contents));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+                }
+        }
+
+        self->message->lazy_cursor_owner = self;
+        self->message->lazy_cursor_index = 0;
+        Py_RETURN_NONE;
+}
+
+static PyObject* _lazy_view_seek(SdBusLazyViewObject* self, Py_ssize_t index) {
+        SdBusMessageObject* message_object = self->message;
+        if (message_object->lazy_cursor_owner != self || message_object->lazy_cursor_index > index) {
+                CALL_PYTHON_EXPECT_NONE(_lazy_view_enter(self));
+        }
+
+        Py_ssize_t current_index = message_object->lazy_cursor_index;
+        message_object->lazy_cursor_owner = NULL;
+        for (; current_index < index; ++current_index) {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message_object->message_ref, NULL));
+        }
+        message_object->lazy_cursor_owner = self;
+        message_object->lazy_cursor_index = index;
+        Py_RETURN_NONE;
+}
+
+static PyObject* _lazy_view_load(SdBusLazyViewObject* self) {
+        // Counts the elements and reads the keys of dicts
+        if (self->elements_count >= 0) {
+                Py_RETURN_NONE;
+        }
+        sd_bus_message* message = self->message->message_ref;
+        const SdBusSignatureNode* element_node = self->path[self->path_depth - 1].node + 1;
+        PyObject* new_keys_index CLEANUP_PY_OBJECT = NULL;
+        if (element_node->type == 'e') {
+                new_keys_index = CALL_PYTHON_AND_CHECK(PyDict_New());
+        }
+
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_enter(self));
+        self->message->lazy_cursor_owner = NULL;
+        _Parse_state read_parser = {
+            .message = message,
+            .flags = self->flags,
+            .limits = _SdBusDecodeLimits_or_null(&self->message->decode_limits),
+            .budget = &self->message->decode_budget,
+            .depth = self->path_depth,
+        };
+        Py_ssize_t elements_count = 0;
+        while (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(message, 0)) == 0) {
+                SD_BUS_PY_DECODE_CHARGE((&read_parser), 0, 1, 0);
+                if (new_keys_index != NULL) {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(message, 'e', element_node->contents));
+                        PyObject* key_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(&read_parser, element_node + 1));
+                        PyObject* index_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyLong_FromSsize_t(elements_count));
+                        CALL_PYTHON_INT_CHECK(PyDict_SetItem(new_keys_index, key_object, index_object));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(message));
+                } else {
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+                }
+                elements_count++;
+        }
+
+        self->elements = PyMem_Calloc(elements_count > 0 ? (size_t)elements_count : 1, sizeof(PyObject*));
+        if (self->elements == NULL) {
+                return PyErr_NoMemory();
+        }
+        self->elements_count = elements_count;
+        Py_XINCREF(new_keys_index);
+        self->keys_index = new_keys_index;
+        Py_RETURN_NONE;
+}
+
+static PyObject* _lazy_view_get_element(SdBusLazyViewObject* self, Py_ssize_t index) {
+        // Index must be already checked against elements_count
+        if (self->elements[index] != NULL) {
+                Py_INCREF(self->elements[index]);
+                return self->elements[index];
+        }
+        sd_bus_message* message = self->message->message_ref;
+        const SdBusSignatureNode* element_node = self->path[self->path_depth - 1].node + 1;
+        const SdBusSignatureNode* value_node = element_node;
+
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_seek(self, index));
+        self->message->lazy_cursor_owner = NULL;
+        _Parse_state read_parser = {
+            .message = message,
+            .flags = self->flags,
+            .limits = _SdBusDecodeLimits_or_null(&self->message->decode_limits),
+            .budget = &self->message->decode_budget,
+            .depth = self->path_depth,
+        };
+        if (element_node->type == 'e') {
+                // "{sv}"
+                //    ^
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(message, 'e', element_node->contents));
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+                value_node = element_node + 2;
+        }
+
+        PyObject* new_element CLEANUP_PY_OBJECT = NULL;
+        if (_lazy_node_is_view(value_node, self->flags)) {
+                CALL_PYTHON_INT_CHECK(_lazy_view_charge(&read_parser));
+                new_element = CALL_PYTHON_AND_CHECK(
+                    _lazy_view_new(self->message, self->plan_capsule, self->flags, self->path, self->path_depth, value_node, index));
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(message, NULL));
+        } else {
+                new_element = CALL_PYTHON_AND_CHECK(_iter_complete(&read_parser, value_node));
+        }
+
+        if (element_node->type == 'e') {
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(message));
+        }
+        self->message->lazy_cursor_owner = self;
+        self->message->lazy_cursor_index = index + 1;
+
+        Py_INCREF(new_element);
+        self->elements[index] = new_element;
+        Py_INCREF(new_element);
+        return new_element;
+}
+
+static PyObject* _lazy_decode_message(SdBusMessageObject* self, PyObject* plan_capsule, unsigned long flags) {
+        // Top level arrays and dicts become views, everything else is decoded.
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_rewind(self->message_ref, 1));
+
+        _Parse_state read_parser = {
+            .message = self->message_ref,
+            .flags = flags,
+            .limits = _SdBusDecodeLimits_or_null(&self->decode_limits),
+            .budget = &self->decode_budget,
+        };
+        PyObject* new_tuple CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyTuple_New((Py_ssize_t)plan->top_level_count));
+        const SdBusSignatureNode* node = plan->nodes;
+        for (size_t i = 0; i < plan->top_level_count; ++i) {
+                PyObject* new_object = NULL;
+                if (_lazy_node_is_view(node, flags)) {
+                        CALL_PYTHON_INT_CHECK(_lazy_view_charge(&read_parser));
+                        new_object = CALL_PYTHON_AND_CHECK(_lazy_view_new(self, plan_capsule, flags, NULL, 0, node, (Py_ssize_t)i));
+                        SD_BUS_PY_TUPLE_SET_ITEM(new_tuple, i, new_object);
+                        CALL_SD_BUS_AND_CHECK(sd_bus_message_skip(self->message_ref, NULL));
+                } else {
+                        new_object = CALL_PYTHON_AND_CHECK(_iter_complete(&read_parser, node));
+                        SD_BUS_PY_TUPLE_SET_ITEM(new_tuple, i, new_object);
+                }
+                node += node->subtree_size;
+        }
+
+        if (plan->top_level_count == 1) {
+                PyObject* single_object = SD_BUS_PY_TUPLE_GET_ITEM(new_tuple, 0);
+                Py_INCREF(single_object);
+                return single_object;
+        }
+        Py_INCREF(new_tuple);
+        return new_tuple;
+}
+
+static int _resolve_decode_flags(PyObject* flags_object, PyObject* signature_str, unsigned long* decode_flags) {
+        // Explicit flags are added to the ones set by set_signature_decode_flags
+        *decode_flags = 0;
+        if (flags_object != Py_None) {
+                *decode_flags = PyLong_AsUnsignedLong(flags_object);
+                if (PyErr_Occurred()) {
+                        return -1;
+                }
+        }
+        if (PyDict_Size(signature_decode_flags_dict) == 0) {
+                return 0;
+        }
+        PyObject* signature_flags_object = PyDict_GetItemWithError(signature_decode_flags_dict, signature_str);
+        if (signature_flags_object == NULL) {
+                return PyErr_Occurred() ? -1 : 0;
+        }
+        *decode_flags |= PyLong_AsUnsignedLong(signature_flags_object);
+        return PyErr_Occurred() ? -1 : 0;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_get_contents2(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        if (nargs > 3) {
+                PyErr_Format(PyExc_TypeError, "SdBusMessage.get_contents() takes 0-3 positional arguments but %zd were given", nargs);
+                return NULL;
+        }
+        PyObject* flags_object = nargs > 0 ? args[0] : Py_None;
+        PyObject* projection = nargs > 1 ? args[1] : Py_None;
+        PyObject* struct_types = nargs > 2 ? args[2] : Py_None;
+#else
+static PyObject* SdBusMessage_get_contents2(SdBusMessageObject* self, PyObject* args) {
+        PyObject* flags_object = Py_None;
+        PyObject* projection = Py_None;
+        PyObject* struct_types = Py_None;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "|OOO", &flags_object, &projection, &struct_types, NULL));
+#endif
+        return _SdBusMessage_get_contents(self, flags_object, projection, struct_types);
+}
+
+PyObject* _SdBusMessage_get_contents(SdBusMessageObject* self, PyObject* flags_object, PyObject* projection, PyObject* struct_types) {
+        if (struct_types != Py_None && !PyDict_Check(struct_types)) {
+                PyErr_Format(PyExc_TypeError, "Expected dict of struct types, got %R", struct_types);
+                return NULL;
+        }
+        const char* message_signature = sd_bus_message_get_signature(self->message_ref, 0);
+
+        if (message_signature == NULL) {
+                PyErr_SetString(PyExc_TypeError, "Failed to get message signature.");
+                return NULL;
+        }
+        if (message_signature[0] == '\0') {
+                // Empty message
+                Py_RETURN_NONE;
+        }
+
+        PyObject* signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(message_signature));
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+
+        unsigned long decode_flags = 0;
+        CALL_PYTHON_INT_CHECK(_resolve_decode_flags(flags_object, signature_str, &decode_flags));
+
+        self->lazy_cursor_owner = NULL;
+        // Views of the previous decodes share the new budget
+        self->decode_budget = (SdBusDecodeBudget){0};
+        if (projection != Py_None) {
+                if (decode_flags & SD_BUS_PY_DECODE_LAZY) {
+                        PyErr_SetString(PyExc_ValueError, "Projection can't be used with lazy decoding");
+                        return NULL;
+                }
+                _Parse_state read_parser = {
+                    .message = self->message_ref,
+                    .flags = decode_flags,
+                    .struct_types = struct_types != Py_None ? struct_types : NULL,
+                    .limits = _SdBusDecodeLimits_or_null(&self->decode_limits),
+                    .budget = &self->decode_budget,
+                };
+                // Multiple top level types are projected as a struct
+                if (plan->top_level_count == 1) {
+                        return _iter_projected(&read_parser, plan->nodes, projection);
+                } else {
+                        size_t selected_count = 0;
+                        return _iter_struct_projected(&read_parser, plan->nodes, plan->top_level_count, projection, &selected_count);
+                }
+        }
+        if (decode_flags & SD_BUS_PY_DECODE_LAZY) {
+                // Views rewind to the start of the body which might be
+                // before the current read position after a partial read
+                PyObject* body_plan_capsule CLEANUP_PY_OBJECT =
+                    CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get_from_char_ptr(sd_bus_message_get_signature(self->message_ref, 1)));
+                return _lazy_decode_message(self, body_plan_capsule, decode_flags);
+        }
+
+        _Parse_state read_parser = {
+            .message = self->message_ref,
+            .flags = decode_flags,
+            .struct_types = struct_types != Py_None ? struct_types : NULL,
+            .limits = _SdBusDecodeLimits_or_null(&self->decode_limits),
+            .budget = &self->decode_budget,
+        };
+        /* Parsing strategy
+       Either return a single object (single string, single int, single array)
+       or a tuple of single objects. This mirrors the python function returns.
+      */
+        if (plan->top_level_count == 1) {
+                return _iter_complete(&read_parser, plan->nodes);
+        } else {
+                return _iter_struct(&read_parser, plan->nodes, plan->top_level_count);
+        }
+}
+
+static PyObject* SdBusMessage_get_contents_json(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
+        const char* message_signature = sd_bus_message_get_signature(self->message_ref, 1);
+        if (message_signature == NULL) {
+                PyErr_SetString(PyExc_TypeError, "Failed to get message signature.");
+                return NULL;
+        }
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get_from_char_ptr(message_signature));
+
+        // Whole body is written regardless of the previous reads
+        self->lazy_cursor_owner = NULL;
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_rewind(self->message_ref, 1));
+        return _SdBusJson_dump_message(self->message_ref, _SdBusSignaturePlan_from_capsule(plan_capsule));
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_append_data_json(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(2);
+        SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
+        PyObject* signature_str = args[0];
+        PyObject* json_object = args[1];
+#else
+static PyObject* SdBusMessage_append_data_json(SdBusMessageObject* self, PyObject* args) {
+        PyObject* signature_str = NULL;
+        PyObject* json_object = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "UO", &signature_str, &json_object, NULL));
+#endif
+        PyObject* json_bytes CLEANUP_PY_OBJECT = NULL;
+        if (PyUnicode_Check(json_object)) {
+                json_bytes = CALL_PYTHON_AND_CHECK(PyUnicode_AsUTF8String(json_object));
+        } else if (PyBytes_Check(json_object)) {
+                Py_INCREF(json_object);
+                json_bytes = json_object;
+        } else {
+                PyErr_Format(PyExc_TypeError, "Expected JSON bytes or str, got %R", json_object);
+                return NULL;
+        }
+        char* json_char_ptr = NULL;
+        Py_ssize_t json_length = 0;
+        CALL_PYTHON_INT_CHECK(PyBytes_AsStringAndSize(json_bytes, &json_char_ptr, &json_length));
+
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+        CALL_PYTHON_INT_CHECK(
+            _SdBusJson_load_message(self->message_ref, _SdBusSignaturePlan_from_capsule(plan_capsule), json_char_ptr, (size_t)json_length));
+        Py_RETURN_NONE;
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_read_bytes_into(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        SD_BUS_PY_CHECK_ARGS_NUMBER(1);
+        PyObject* target_object = args[0];
+#else
+static PyObject* SdBusMessage_read_bytes_into(SdBusMessageObject* self, PyObject* args) {
+        PyObject* target_object = NULL;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "O", &target_object, NULL));
+#endif
+        // Reads the next byte array of the message in to the writable buffer
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+        Py_buffer target_buffer CLEANUP_PY_BUFFER = {0};
+        CALL_PYTHON_INT_CHECK(PyObject_GetBuffer(target_object, &target_buffer, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS));
+        Py_ssize_t target_size = target_buffer.len;
+#else
+        PyObject* target_memory_view CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyMemoryView_FromObject(target_object));
+        PyObject* target_bytes_view CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_CallMethod(target_memory_view, "cast", "s", "B"));
+        PyObject* is_read_only CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyObject_GetAttrString(target_bytes_view, "readonly"));
+        if (is_read_only == Py_True) {
+                PyErr_SetString(PyExc_BufferError, "Object is not writable.");
+                return NULL;
+        }
+        Py_ssize_t target_size = PyObject_Size(target_bytes_view);
+        PYTHON_ERR_OCCURED;
+#endif
+
+        const void* char_array = NULL;
+        size_t array_size = 0;
+        self->lazy_cursor_owner = NULL;
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_read_array(self->message_ref, 'y', &char_array, &array_size));
+        if (array_size > (size_t)target_size) {
+                PyErr_Format(PyExc_ValueError, "Byte array of %zu bytes does not fit in to buffer of %zd bytes", array_size, target_size);
+                return NULL;
+        }
+
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+        memcpy(target_buffer.buf, char_array, array_size);
+#else
+        PyObject* array_bytes CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyBytes_FromStringAndSize(char_array, (Py_ssize_t)array_size));
+        CALL_PYTHON_INT_CHECK(PySequence_SetSlice(target_bytes_view, 0, (Py_ssize_t)array_size, array_bytes));
+#endif
+        return PyLong_FromSize_t(array_size);
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_iter_array(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        if (nargs > 1) {
+                PyErr_Format(PyExc_TypeError, "SdBusMessage.iter_array() takes 0-1 positional arguments but %zd were given", nargs);
+                return NULL;
+        }
+        PyObject* flags_object = nargs > 0 ? args[0] : Py_None;
+#else
+static PyObject* SdBusMessage_iter_array(SdBusMessageObject* self, PyObject* args) {
+        PyObject* flags_object = Py_None;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "|O", &flags_object, NULL));
+#endif
+        // Iterates over elements of the next array of the message
+        char container_type = 0;
+        const char* container_contents = NULL;
+        if (CALL_SD_BUS_AND_CHECK(sd_bus_message_peek_type(self->message_ref, &container_type, &container_contents)) == 0) {
+                PyErr_SetString(PyExc_TypeError, "No more data in the message");
+                return NULL;
+        }
+        if (container_type != 'a') {
+                PyErr_Format(PyExc_TypeError, "Expected array, got type '%c'", (int)container_type);
+                return NULL;
+        }
+
+        PyObject* signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(sd_bus_message_get_signature(self->message_ref, 1)));
+        unsigned long decode_flags = 0;
+        CALL_PYTHON_INT_CHECK(_resolve_decode_flags(flags_object, signature_str, &decode_flags));
+
+        PyObject* array_signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromFormat("a%s", container_contents));
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(array_signature_str));
+
+        PyObject* new_iterator_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusMessageArrayIterator_class));
+        SdBusMessageArrayIteratorObject* new_iterator = (SdBusMessageArrayIteratorObject*)new_iterator_object;
+
+        self->lazy_cursor_owner = NULL;
+        self->decode_budget = (SdBusDecodeBudget){0};
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(self->message_ref, 'a', container_contents));
+        Py_INCREF(self);
+        new_iterator->message = self;
+        Py_INCREF(plan_capsule);
+        new_iterator->plan_capsule = plan_capsule;
+        new_iterator->flags = decode_flags;
+
+        Py_INCREF(new_iterator_object);
+        return new_iterator_object;
+}
+
+static SdBusCredsObject* SdBusMessage_get_creds(SdBusMessageObject* self, PyObject* Py_UNUSED(args)) {
+        SdBusCredsObject* new_creds_object CLEANUP_SD_BUS_CREDS =
+            (SdBusCredsObject*)CALL_PYTHON_AND_CHECK(PyObject_CallFunctionObjArgs(SdBusCreds_class, NULL));
+        _SdBusCreds_set_creds_from_message(new_creds_object, self->message_ref);
         Py_INCREF(new_creds_object);
         return new_creds_object;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static SdBusMessageObject* SdBusMessage_create_error_reply(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(2);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyUnicode_Check);
@@ -1027,7 +2505,7 @@ static SdBusMessageObject* SdBusMessage_create_error_reply(SdBusMessageObject* s
         return new_reply_message;
 }
 
-#ifndef Py_LIMITED_API
+#ifdef SD_BUS_PY_HAS_FASTCALL
 static PyObject* SdBusMessage_set_allow_interactive_authorization(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
         SD_BUS_PY_CHECK_ARGS_NUMBER(1);
         SD_BUS_PY_CHECK_ARG_CHECK_FUNC(0, PyBool_Check);
@@ -1041,6 +2519,16 @@ static PyObject* SdBusMessage_set_allow_interactive_authorization(SdBusMessageOb
         Py_RETURN_NONE;
 }
 
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusMessage_set_decode_limits(SdBusMessageObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args, nargs));
+#else
+static PyObject* SdBusMessage_set_decode_limits(SdBusMessageObject* self, PyObject* args) {
+        CALL_PYTHON_INT_CHECK(_SdBusDecodeLimits_from_args(&self->decode_limits, args));
+#endif
+        Py_RETURN_NONE;
+}
+
 static PyMethodDef SdBusMessage_methods[] = {
     {"append_data", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_append_data, SD_BUS_PY_METH, "Append basic data based on signature."},
     {"open_container", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_open_container, SD_BUS_PY_METH, "Open container for writing"},
@@ -1049,12 +2537,17 @@ static PyMethodDef SdBusMessage_methods[] = {
     {"exit_container", (PyCFunction)SdBusMessage_exit_container, METH_NOARGS, "Exit container"},
     {"dump", (PyCFunction)SdBusMessage_dump, METH_NOARGS, "Dump message to stdout"},
     {"seal", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_seal, SD_BUS_PY_METH, "Seal message contents"},
-    {"get_contents", (PyCFunction)SdBusMessage_get_contents2, METH_NOARGS, "Iterate over message contents"},
+    {"get_contents", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_get_contents2, SD_BUS_PY_METH, "Iterate over message contents"},
+    {"get_contents_json", (PyCFunction)SdBusMessage_get_contents_json, METH_NOARGS, "Write message contents as JSON bytes"},
+    {"append_data_json", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_append_data_json, SD_BUS_PY_METH, "Append data from JSON based on signature"},
+    {"read_bytes_into", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_read_bytes_into, SD_BUS_PY_METH, "Read next byte array in to the writable buffer"},
+    {"iter_array", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_iter_array, SD_BUS_PY_METH, "Iterate over elements of the next array"},
     {"get_credentials", (PyCFunction)SdBusMessage_get_creds, METH_NOARGS, "Get message credentials"},
     {"create_reply", (PyCFunction)SdBusMessage_create_reply, METH_NOARGS, "Create reply message"},
     {"create_error_reply", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_create_error_reply, SD_BUS_PY_METH, "Create error reply with error name and error message"},
     {"send", (PyCFunction)SdBusMessage_send, METH_NOARGS, "Queue message to be sent"},
     {"set_allow_interactive_authorization", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_set_allow_interactive_authorization, SD_BUS_PY_METH, "Set whether the receiver should do interactive authorization."},
+    {"set_decode_limits", (SD_BUS_PY_FUNC_TYPE)SdBusMessage_set_decode_limits, SD_BUS_PY_METH, "Set limits of decoding message contents"},
     {NULL, NULL, 0, NULL},
 };
 
@@ -1098,7 +2591,7 @@ static int SdBusMessage_timeout_usec_setter(SdBusMessageObject* self, PyObject*
 static PyObject* SdBusMessage_destination_getter(SdBusMessageObject* self, void* Py_UNUSED(closure)) {
         const char* destination_char_ptr = sd_bus_message_get_destination(self->message_ref);
         if (NULL != destination_char_ptr) {
-                return PyUnicode_FromString(destination_char_ptr);
+                return _SdBusStringCache_get(destination_char_ptr);
         } else {
                 Py_RETURN_NONE;
         }
@@ -1107,7 +2600,7 @@ static PyObject* SdBusMessage_destination_getter(SdBusMessageObject* self, void*
 static PyObject* SdBusMessage_path_getter(SdBusMessageObject* self, void* Py_UNUSED(closure)) {
         const char* path_char_ptr = sd_bus_message_get_path(self->message_ref);
         if (NULL != path_char_ptr) {
-                return PyUnicode_FromString(path_char_ptr);
+                return _SdBusStringCache_get(path_char_ptr);
         } else {
                 Py_RETURN_NONE;
         }
@@ -1116,7 +2609,7 @@ static PyObject* SdBusMessage_path_getter(SdBusMessageObject* self, void* Py_UNU
 static PyObject* SdBusMessage_interface_getter(SdBusMessageObject* self, void* Py_UNUSED(closure)) {
         const char* interface_char_ptr = sd_bus_message_get_interface(self->message_ref);
         if (NULL != interface_char_ptr) {
-                return PyUnicode_FromString(interface_char_ptr);
+                return _SdBusStringCache_get(interface_char_ptr);
         } else {
                 Py_RETURN_NONE;
         }
@@ -1125,7 +2618,7 @@ static PyObject* SdBusMessage_interface_getter(SdBusMessageObject* self, void* P
 static PyObject* SdBusMessage_member_getter(SdBusMessageObject* self, void* Py_UNUSED(closure)) {
         const char* member_char_ptr = sd_bus_message_get_member(self->message_ref);
         if (NULL != member_char_ptr) {
-                return PyUnicode_FromString(member_char_ptr);
+                return _SdBusStringCache_get(member_char_ptr);
         } else {
                 Py_RETURN_NONE;
         }
@@ -1134,7 +2627,7 @@ static PyObject* SdBusMessage_member_getter(SdBusMessageObject* self, void* Py_U
 static PyObject* SdBusMessage_sender_getter(SdBusMessageObject* self, void* Py_UNUSED(closure)) {
         const char* sender_char_ptr = sd_bus_message_get_sender(self->message_ref);
         if (NULL != sender_char_ptr) {
-                return PyUnicode_FromString(sender_char_ptr);
+                return _SdBusStringCache_get(sender_char_ptr);
         } else {
                 Py_RETURN_NONE;
         }
@@ -1145,12 +2638,16 @@ static int SdBusMessage_sender_setter(SdBusMessageObject* self, PyObject* new_va
                 PyErr_SetString(PyExc_AttributeError, "Can't delete sender");
                 return -1;
         }
-        Py_ssize_t length = -1;
-        const char* new_sender = PyUnicode_AsUTF8AndSize(new_value, &length);
-        if (length == -1) {
+        if (!PyUnicode_Check(new_value)) {
                 PyErr_Format(PyExc_TypeError, "str, got %R", new_value);
                 return -1;
         }
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
+        const char* new_sender = SD_BUS_PY_UNICODE_AS_CHAR_PTR_ERROR_ACTION(new_value, return -1);
+#else
+        PyObject* new_sender_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES_ERROR_ACTION(new_value, return -1);
+        const char* new_sender = SD_BUS_PY_BYTES_AS_CHAR_PTR_ERROR_ACTION(new_sender_bytes, return -1);
+#endif
         CALL_SD_BUS_CHECK_RETURN_NEG1(sd_bus_message_set_sender(self->message_ref, new_sender));
         return 0;
 }
@@ -1187,3 +2684,453 @@ PyType_Spec SdBusMessageType = {
             {0, NULL},
         },
 };
+
+#ifdef SD_BUS_PY_HAS_BUFFER_API
+static void SdBusMessageBuffer_dealloc(SdBusMessageBufferObject* self) {
+        sd_bus_message_unref(self->message_ref);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+static int SdBusMessageBuffer_getbuffer(SdBusMessageBufferObject* self, Py_buffer* view, int flags) {
+        return PyBuffer_FillInfo(view, (PyObject*)self, (void*)self->array_ptr, (Py_ssize_t)self->array_size, 1, flags);
+}
+
+PyType_Spec SdBusMessageBufferType = {
+    .name = "sd_bus_internals.SdBusMessageBuffer",
+    .basicsize = sizeof(SdBusMessageBufferObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusMessageBuffer_dealloc},
+            {Py_bf_getbuffer, (getbufferproc)SdBusMessageBuffer_getbuffer},
+            {0, NULL},
+        },
+};
+#endif
+
+// SdBusLazySequence and SdBusLazyMapping
+
+static void SdBusLazyView_dealloc(SdBusLazyViewObject* self) {
+        if (self->message != NULL && self->message->lazy_cursor_owner == self) {
+                self->message->lazy_cursor_owner = NULL;
+        }
+        if (self->elements != NULL) {
+                for (Py_ssize_t i = 0; i < self->elements_count; ++i) {
+                        Py_XDECREF(self->elements[i]);
+                }
+                PyMem_Free(self->elements);
+        }
+        PyMem_Free(self->path);
+        Py_XDECREF(self->keys_index);
+        Py_XDECREF(self->plan_capsule);
+        Py_XDECREF(self->message);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+static Py_ssize_t SdBusLazyView_length(SdBusLazyViewObject* self) {
+        PyObject* load_result CLEANUP_PY_OBJECT = _lazy_view_load(self);
+        if (load_result == NULL) {
+                return -1;
+        }
+        if (self->keys_index != NULL) {
+                // Repeated keys override previous entries
+                return PyDict_Size(self->keys_index);
+        }
+        return self->elements_count;
+}
+
+static PyObject* SdBusLazySequence_item(SdBusLazyViewObject* self, Py_ssize_t index) {
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_load(self));
+        if (index < 0 || index >= self->elements_count) {
+                PyErr_SetString(PyExc_IndexError, "index out of range");
+                return NULL;
+        }
+        return _lazy_view_get_element(self, index);
+}
+
+static PyObject* SdBusLazySequence_subscript(SdBusLazyViewObject* self, PyObject* key) {
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_load(self));
+        if (PySlice_Check(key)) {
+                Py_ssize_t start = 0, stop = 0, step = 0;
+                CALL_PYTHON_INT_CHECK(PySlice_Unpack(key, &start, &stop, &step));
+                Py_ssize_t slice_length = PySlice_AdjustIndices(self->elements_count, &start, &stop, step);
+                PyObject* new_list CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyList_New(0));
+                for (Py_ssize_t i = 0, index = start; i < slice_length; ++i, index += step) {
+                        PyObject* element CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_lazy_view_get_element(self, index));
+                        CALL_PYTHON_INT_CHECK(PyList_Append(new_list, element));
+                }
+                Py_INCREF(new_list);
+                return new_list;
+        }
+
+        Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        PYTHON_ERR_OCCURED;
+        if (index < 0) {
+                index += self->elements_count;
+        }
+        return SdBusLazySequence_item(self, index);
+}
+
+static PyObject* SdBusLazySequence_index(SdBusLazyViewObject* self, PyObject* value) {
+        Py_ssize_t elements_count = CALL_PYTHON_INT_CHECK(SdBusLazyView_length(self));
+        for (Py_ssize_t i = 0; i < elements_count; ++i) {
+                PyObject* element CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_lazy_view_get_element(self, i));
+                if (CALL_PYTHON_INT_CHECK(PyObject_RichCompareBool(element, value, Py_EQ))) {
+                        return PyLong_FromSsize_t(i);
+                }
+        }
+        PyErr_Format(PyExc_ValueError, "%R is not in sequence", value);
+        return NULL;
+}
+
+static PyObject* SdBusLazySequence_count(SdBusLazyViewObject* self, PyObject* value) {
+        Py_ssize_t elements_count = CALL_PYTHON_INT_CHECK(SdBusLazyView_length(self));
+        Py_ssize_t value_count = 0;
+        for (Py_ssize_t i = 0; i < elements_count; ++i) {
+                PyObject* element CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_lazy_view_get_element(self, i));
+                value_count += CALL_PYTHON_INT_CHECK(PyObject_RichCompareBool(element, value, Py_EQ));
+        }
+        return PyLong_FromSsize_t(value_count);
+}
+
+static PyObject* SdBusLazySequence_richcompare(PyObject* self, PyObject* other, int op) {
+        if (op != Py_EQ && op != Py_NE) {
+                Py_RETURN_NOTIMPLEMENTED;
+        }
+        PyObject* self_list CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PySequence_List(self));
+        return PyObject_RichCompare(self_list, other, op);
+}
+
+static PyMethodDef SdBusLazySequence_methods[] = {
+    {"index", (PyCFunction)SdBusLazySequence_index, METH_O, "Index of the first element equal to value."},
+    {"count", (PyCFunction)SdBusLazySequence_count, METH_O, "Number of elements equal to value."},
+    {NULL, NULL, 0, NULL},
+};
+
+PyType_Spec SdBusLazySequenceType = {
+    .name = "sd_bus_internals.SdBusLazySequence",
+    .basicsize = sizeof(SdBusLazyViewObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusLazyView_dealloc},
+            {Py_tp_methods, SdBusLazySequence_methods},
+            {Py_tp_richcompare, SdBusLazySequence_richcompare},
+            {Py_sq_length, (lenfunc)SdBusLazyView_length},
+            {Py_sq_item, (ssizeargfunc)SdBusLazySequence_item},
+            {Py_mp_length, (lenfunc)SdBusLazyView_length},
+            {Py_mp_subscript, (binaryfunc)SdBusLazySequence_subscript},
+            {0, NULL},
+        },
+};
+
+static PyObject* _lazy_mapping_get_value(SdBusLazyViewObject* self, PyObject* key) {
+        // Returns NULL without exception set if the key is missing
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_load(self));
+        PyObject* index_object = PyDict_GetItemWithError(self->keys_index, key);
+        if (index_object == NULL) {
+                return NULL;
+        }
+        Py_ssize_t index = PyLong_AsSsize_t(index_object);
+        PYTHON_ERR_OCCURED;
+        return _lazy_view_get_element(self, index);
+}
+
+static PyObject* SdBusLazyMapping_subscript(SdBusLazyViewObject* self, PyObject* key) {
+        PyObject* value = _lazy_mapping_get_value(self, key);
+        if (value == NULL && !PyErr_Occurred()) {
+                PyErr_SetObject(PyExc_KeyError, key);
+        }
+        return value;
+}
+
+static int SdBusLazyMapping_contains(SdBusLazyViewObject* self, PyObject* key) {
+        PyObject* load_result CLEANUP_PY_OBJECT = _lazy_view_load(self);
+        if (load_result == NULL) {
+                return -1;
+        }
+        return PyDict_Contains(self->keys_index, key);
+}
+
+static PyObject* SdBusLazyMapping_iter(SdBusLazyViewObject* self) {
+        CALL_PYTHON_EXPECT_NONE(_lazy_view_load(self));
+        return PyObject_GetIter(self->keys_index);
+}
+
+#ifdef SD_BUS_PY_HAS_FASTCALL
+static PyObject* SdBusLazyMapping_get(SdBusLazyViewObject* self, PyObject* const* args, Py_ssize_t nargs) {
+        if (nargs < 1 || nargs > 2) {
+                PyErr_Format(PyExc_TypeError, "get() takes 1-2 positional arguments but %zd were given", nargs);
+                return NULL;
+        }
+        PyObject* key = args[0];
+        PyObject* default_value = nargs > 1 ? args[1] : Py_None;
+#else
+static PyObject* SdBusLazyMapping_get(SdBusLazyViewObject* self, PyObject* args) {
+        PyObject* key = NULL;
+        PyObject* default_value = Py_None;
+        CALL_PYTHON_BOOL_CHECK(PyArg_ParseTuple(args, "O|O", &key, &default_value, NULL));
+#endif
+        PyObject* value = _lazy_mapping_get_value(self, key);
+        if (value == NULL && !PyErr_Occurred()) {
+                Py_INCREF(default_value);
+                return default_value;
+        }
+        return value;
+}
+
+static PyObject* SdBusLazyMapping_keys(SdBusLazyViewObject* self, PyObject* Py_UNUSED(args)) {
+        return PyObject_CallFunctionObjArgs(keys_view_class, self, NULL);
+}
+
+static PyObject* SdBusLazyMapping_values(SdBusLazyViewObject* self, PyObject* Py_UNUSED(args)) {
+        return PyObject_CallFunctionObjArgs(values_view_class, self, NULL);
+}
+
+static PyObject* SdBusLazyMapping_items(SdBusLazyViewObject* self, PyObject* Py_UNUSED(args)) {
+        return PyObject_CallFunctionObjArgs(items_view_class, self, NULL);
+}
+
+static PyObject* SdBusLazyMapping_richcompare(PyObject* self, PyObject* other, int op) {
+        if (op != Py_EQ && op != Py_NE) {
+                Py_RETURN_NOTIMPLEMENTED;
+        }
+        PyObject* self_dict CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyDict_New());
+        CALL_PYTHON_INT_CHECK(PyDict_Merge(self_dict, self, 1));
+        return PyObject_RichCompare(self_dict, other, op);
+}
+
+static PyMethodDef SdBusLazyMapping_methods[] = {
+    {"get", (SD_BUS_PY_FUNC_TYPE)SdBusLazyMapping_get, SD_BUS_PY_METH, "Value of the key or default."},
+    {"keys", (PyCFunction)SdBusLazyMapping_keys, METH_NOARGS, "View of the dict keys."},
+    {"values", (PyCFunction)SdBusLazyMapping_values, METH_NOARGS, "View of the dict values."},
+    {"items", (PyCFunction)SdBusLazyMapping_items, METH_NOARGS, "View of the dict items."},
+    {NULL, NULL, 0, NULL},
+};
+
+PyType_Spec SdBusLazyMappingType = {
+    .name = "sd_bus_internals.SdBusLazyMapping",
+    .basicsize = sizeof(SdBusLazyViewObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusLazyView_dealloc},
+            {Py_tp_methods, SdBusLazyMapping_methods},
+            {Py_tp_richcompare, SdBusLazyMapping_richcompare},
+            {Py_tp_iter, (getiterfunc)SdBusLazyMapping_iter},
+            {Py_sq_contains, (objobjproc)SdBusLazyMapping_contains},
+            {Py_mp_length, (lenfunc)SdBusLazyView_length},
+            {Py_mp_subscript, (binaryfunc)SdBusLazyMapping_subscript},
+            {0, NULL},
+        },
+};
+
+// SdBusMessageArrayIterator
+
+static void SdBusMessageArrayIterator_dealloc(SdBusMessageArrayIteratorObject* self) {
+        Py_XDECREF(self->plan_capsule);
+        Py_XDECREF(self->message);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+static PyObject* _array_iterator_next_element(SdBusMessageArrayIteratorObject* self) {
+        sd_bus_message* message = self->message->message_ref;
+        if (CALL_SD_BUS_AND_CHECK(sd_bus_message_at_end(message, 0)) > 0) {
+                self->finished = 1;
+                CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(message));
+                return NULL;
+        }
+
+        const SdBusSignatureNode* element_node = _SdBusSignaturePlan_from_capsule(self->plan_capsule)->nodes + 1;
+        // Elements are inside the array
+        _Parse_state read_parser = {
+            .message = message,
+            .flags = self->flags,
+            .limits = _SdBusDecodeLimits_or_null(&self->message->decode_limits),
+            .budget = &self->message->decode_budget,
+            .depth = 1,
+        };
+        SD_BUS_PY_DECODE_CHARGE((&read_parser), 0, 1, 0);
+        if (element_node->type != 'e') {
+                return _iter_complete(&read_parser, element_node);
+        }
+        // Dict entries are returned as key and value tuples
+        const SdBusSignatureNode* key_node = element_node + 1;
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_enter_container(message, 'e', element_node->contents));
+        PyObject* key_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(&read_parser, key_node));
+        PyObject* value_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_iter_complete(&read_parser, key_node + key_node->subtree_size));
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_exit_container(message));
+        return PyTuple_Pack(2, key_object, value_object);
+}
+
+static PyObject* SdBusMessageArrayIterator_next(SdBusMessageArrayIteratorObject* self) {
+        if (self->finished) {
+                return NULL;
+        }
+        self->message->lazy_cursor_owner = NULL;
+        PyObject* next_element = _array_iterator_next_element(self);
+        if (next_element == NULL) {
+                // Message position is unknown after errors
+                self->finished = 1;
+        }
+        return next_element;
+}
+
+PyType_Spec SdBusMessageArrayIteratorType = {
+    .name = "sd_bus_internals.SdBusMessageArrayIterator",
+    .basicsize = sizeof(SdBusMessageArrayIteratorObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusMessageArrayIterator_dealloc},
+            {Py_tp_iter, PyObject_SelfIter},
+            {Py_tp_iternext, (iternextfunc)SdBusMessageArrayIterator_next},
+            {0, NULL},
+        },
+};
+
+// SdBusEncodedValue
+
+PyObject* _SdBusEncodedValue_new(sd_bus* bus, PyObject* signature_str, PyObject* value_object) {
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(signature_str));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        if (plan->top_level_count != 1) {
+                PyErr_Format(PyExc_TypeError, "Encoded value signature must be a single complete type, got %R", signature_str);
+                return NULL;
+        }
+
+        PyObject* new_encoded_object CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(SD_BUS_PY_CLASS_DUNDER_NEW(SdBusEncodedValue_class));
+        SdBusEncodedValueObject* new_encoded_value = (SdBusEncodedValueObject*)new_encoded_object;
+        Py_INCREF(signature_str);
+        new_encoded_value->signature = signature_str;
+
+        // Scratch message is never sent
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_new_method_call(bus, &new_encoded_value->message_ref, NULL, "/", NULL, "EncodedValue"));
+        _Parse_state parser_state = {
+            .message = new_encoded_value->message_ref,
+        };
+        CALL_PYTHON_INT_CHECK(_resolve_encode_flags(signature_str, &parser_state.flags));
+        CALL_PYTHON_EXPECT_NONE(_parse_complete(value_object, &parser_state, plan->nodes));
+        // Message has to be sealed to be read from
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_seal(new_encoded_value->message_ref, 1, 0));
+
+        Py_INCREF(new_encoded_object);
+        return new_encoded_object;
+}
+
+static void SdBusEncodedValue_dealloc(SdBusEncodedValueObject* self) {
+        sd_bus_message_unref(self->message_ref);
+        Py_XDECREF(self->signature);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+static PyObject* SdBusEncodedValue_signature_getter(SdBusEncodedValueObject* self, void* Py_UNUSED(closure)) {
+        if (self->signature == NULL) {
+                Py_RETURN_NONE;
+        }
+        Py_INCREF(self->signature);
+        return self->signature;
+}
+
+static PyObject* SdBusEncodedValue_get_contents(SdBusEncodedValueObject* self, PyObject* Py_UNUSED(args)) {
+        if (self->message_ref == NULL) {
+                PyErr_SetString(PyExc_ValueError, "Encoded value is empty. Use SdBus.new_encoded_value to create one.");
+                return NULL;
+        }
+        PyObject* plan_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_get(self->signature));
+        const SdBusSignaturePlan* plan = _SdBusSignaturePlan_from_capsule(plan_capsule);
+        CALL_SD_BUS_AND_CHECK(sd_bus_message_rewind(self->message_ref, 1));
+        _Parse_state read_parser = {
+            .message = self->message_ref,
+        };
+        return _iter_complete(&read_parser, plan->nodes);
+}
+
+static PyGetSetDef SdBusEncodedValue_properties[] = {
+    {"signature", (getter)SdBusEncodedValue_signature_getter, NULL, "Signature of the encoded value", NULL},
+    {0},
+};
+
+static PyMethodDef SdBusEncodedValue_methods[] = {
+    {"get_contents", (PyCFunction)SdBusEncodedValue_get_contents, METH_NOARGS, "Decode the encoded value"},
+    {NULL, NULL, 0, NULL},
+};
+
+PyType_Spec SdBusEncodedValueType = {
+    .name = "sd_bus_internals.SdBusEncodedValue",
+    .basicsize = sizeof(SdBusEncodedValueObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_dealloc, (destructor)SdBusEncodedValue_dealloc},
+            {Py_tp_methods, SdBusEncodedValue_methods},
+            {Py_tp_getset, SdBusEncodedValue_properties},
+            {0, NULL},
+        },
+};
+
+// SealedMemfd
+
+static int SealedMemfd_init(SealedMemfdObject* self, PyObject* args, PyObject* kwds) {
+        static char* kwlist[] = {"data", NULL};
+        PyObject* data_object = NULL;
+        if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:SealedMemfd", kwlist, &data_object)) {
+                return -1;
+        }
+        if (!SD_BUS_PY_CHECK_BUFFER(data_object)) {
+                PyErr_Format(PyExc_TypeError, "Expected bytes like object, got %R", data_object);
+                return -1;
+        }
+        Py_INCREF(data_object);
+        Py_XDECREF(self->data);
+        self->data = data_object;
+        return 0;
+}
+
+static void SealedMemfd_dealloc(SealedMemfdObject* self) {
+        Py_XDECREF(self->data);
+
+        SD_BUS_DEALLOC_TAIL;
+}
+
+static PyObject* SealedMemfd_data_getter(SealedMemfdObject* self, void* Py_UNUSED(closure)) {
+        if (self->data == NULL) {
+                Py_RETURN_NONE;
+        }
+        Py_INCREF(self->data);
+        return self->data;
+}
+
+static PyGetSetDef SealedMemfd_properties[] = {
+    {"data", (getter)SealedMemfd_data_getter, NULL, "Data that will be sent in the memfd", NULL},
+    {0},
+};
+
+PyType_Spec SealedMemfdType = {
+    .name = "sd_bus_internals.SealedMemfd",
+    .basicsize = sizeof(SealedMemfdObject),
+    .itemsize = 0,
+    .flags = Py_TPFLAGS_DEFAULT,
+    .slots =
+        (PyType_Slot[]){
+            {Py_tp_new, PyType_GenericNew},
+            {Py_tp_init, (initproc)SealedMemfd_init},
+            {Py_tp_dealloc, (destructor)SealedMemfd_dealloc},
+            {Py_tp_getset, SealedMemfd_properties},
+            {0, NULL},
+        },
+};
@@ -0,0 +1,309 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+    Copyright (C) 2020, 2021 igo95862
+
+    This file is part of python-sdbus
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+#include "sd_bus_internals.h"
+
+// Signature plans
+//
+// A signature plan is the signature flattened in to the pre-order array
+// of complete types. Every container node is followed by its children
+// and subtree_size allows to jump over the whole subtree to the next sibling.
+//
+// "sa{sv}" compiles to:
+//      [0] 's'
+//      [1] 'a' contents "{sv}"
+//      [2]   'e' contents "sv"
+//      [3]     's'
+//      [4]     'v'
+//
+// Plans are immutable once compiled and shared between all
+// messages through the signature_plan_cache dict.
+
+#define SD_BUS_PY_SIGNATURE_PLAN_CAPSULE_NAME "sd_bus_internals.signature_plan"
+
+typedef struct {
+        char type;
+        size_t start;
+        size_t end;
+        size_t children_count;
+        size_t subtree_size;
+} _Signature_compile_node;
+
+typedef struct {
+        const char* signature;
+        size_t index;
+        size_t nodes_count;
+        _Signature_compile_node nodes[SD_BUS_PY_MAX_SIGNATURE_LENGTH];
+} _Signature_compile_state;
+
+static int _is_basic_type(char type_char) {
+        switch (type_char) {
+                case 'y':
+                case 'b':
+                case 'n':
+                case 'q':
+                case 'i':
+                case 'u':
+                case 'x':
+                case 't':
+                case 'd':
+                case 'h':
+                case 's':
+                case 'o':
+                case 'g':
+                        return 1;
+                default:
+                        return 0;
+        }
+}
+
+static int _compile_complete(_Signature_compile_state* state) {
+        const char* signature = state->signature;
+        size_t node_index = state->nodes_count++;
+        _Signature_compile_node* node = &state->nodes[node_index];
+        node->start = state->index;
+        node->children_count = 0;
+
+        char current_char = signature[state->index];
+        switch (current_char) {
+                case '\0': {
+                        PyErr_SetString(PyExc_TypeError, "Data signature too short");
+                        return -1;
+                }
+                case '}': {
+                        PyErr_SetString(PyExc_TypeError,
+                                        "End of dict reached instead "
+                                        "of complete type");
+                        return -1;
+                }
+                case ')': {
+                        PyErr_SetString(PyExc_TypeError,
+                                        "End of struct reached "
+                                        "instead of complete type");
+                        return -1;
+                }
+                case '{': {
+                        PyErr_SetString(PyExc_TypeError, "Dbus dict can't be outside of array");
+                        return -1;
+                }
+                case 'v': {
+                        node->type = 'v';
+                        state->index++;
+                        break;
+                }
+                case 'a': {
+                        node->type = 'a';
+                        node->children_count = 1;
+                        state->index++;
+                        if (signature[state->index] != '{') {
+                                if (_compile_complete(state) < 0) {
+                                        return -1;
+                                }
+                                break;
+                        }
+                        // "...a{sv}..."
+                        //      ^
+                        size_t dict_index = state->nodes_count++;
+                        _Signature_compile_node* dict_node = &state->nodes[dict_index];
+                        dict_node->type = 'e';
+                        dict_node->start = state->index;
+                        dict_node->children_count = 2;
+                        state->index++;
+                        if (!_is_basic_type(signature[state->index])) {
+                                PyErr_SetString(PyExc_TypeError, "Dict key must be a basic type");
+                                return -1;
+                        }
+                        if (_compile_complete(state) < 0) {
+                                return -1;
+                        }
+                        if (_compile_complete(state) < 0) {
+                                return -1;
+                        }
+                        if (signature[state->index] != '}') {
+                                PyErr_SetString(PyExc_TypeError, "Dict entry must contain exactly 2 types");
+                                return -1;
+                        }
+                        state->index++;
+                        dict_node->end = state->index;
+                        dict_node->subtree_size = state->nodes_count - dict_index;
+                        break;
+                }
+                case '(': {
+                        node->type = 'r';
+                        state->index++;
+                        while (signature[state->index] != ')') {
+                                if (signature[state->index] == '\0') {
+                                        PyErr_SetString(PyExc_TypeError, "Reached the end of signature before the struct end");
+                                        return -1;
+                                }
+                                if (_compile_complete(state) < 0) {
+                                        return -1;
+                                }
+                                node->children_count++;
+                        }
+                        if (node->children_count == 0) {
+                                PyErr_SetString(PyExc_TypeError, "Empty struct in signature");
+                                return -1;
+                        }
+                        state->index++;
+                        break;
+                }
+                default: {
+                        if (!_is_basic_type(current_char)) {
+                                PyErr_Format(PyExc_TypeError, "Unknown dbus type %c in signature", (int)current_char);
+                                return -1;
+                        }
+                        node->type = current_char;
+                        state->index++;
+                        break;
+                }
+        }
+        node->end = state->index;
+        node->subtree_size = state->nodes_count - node_index;
+        return 0;
+}
+
+static void _SdBusSignaturePlan_capsule_destructor(PyObject* capsule) {
+        PyMem_Free(PyCapsule_GetPointer(capsule, SD_BUS_PY_SIGNATURE_PLAN_CAPSULE_NAME));
+}
+
+static PyObject* _SdBusSignaturePlan_compile(const char* signature) {
+        size_t signature_length = strlen(signature);
+        if (signature_length >= SD_BUS_PY_MAX_SIGNATURE_LENGTH) {
+                PyErr_Format(PyExc_TypeError, "Signature too long: %zu characters", signature_length);
+                return NULL;
+        }
+
+        _Signature_compile_state state = {
+            .signature = signature,
+            .index = 0,
+            .nodes_count = 0,
+        };
+        size_t top_level_count = 0;
+        while (signature[state.index] != '\0') {
+                if (_compile_complete(&state) < 0) {
+                        return NULL;
+                }
+                top_level_count++;
+        }
+
+        // Complete signature of every node is followed by container contents
+        // for structs and dict entries which need the brackets stripped.
+        size_t strings_size = 0;
+        for (size_t i = 0; i < state.nodes_count; ++i) {
+                const _Signature_compile_node* node = &state.nodes[i];
+                strings_size += (node->end - node->start) + 1;
+                if (node->type == 'r' || node->type == 'e') {
+                        strings_size += (node->end - node->start) - 1;
+                }
+        }
+
+        size_t nodes_size = sizeof(SdBusSignatureNode) * state.nodes_count;
+        SdBusSignaturePlan* new_plan = PyMem_Malloc(sizeof(SdBusSignaturePlan) + nodes_size + strings_size);
+        if (new_plan == NULL) {
+                return PyErr_NoMemory();
+        }
+        new_plan->nodes_count = state.nodes_count;
+        new_plan->top_level_count = top_level_count;
+
+        char* strings_pool = ((char*)new_plan->nodes) + nodes_size;
+        for (size_t i = 0; i < state.nodes_count; ++i) {
+                const _Signature_compile_node* node = &state.nodes[i];
+                SdBusSignatureNode* new_node = &new_plan->nodes[i];
+                size_t node_length = node->end - node->start;
+
+                new_node->type = node->type;
+                new_node->children_count = node->children_count;
+                new_node->subtree_size = node->subtree_size;
+
+                memcpy(strings_pool, signature + node->start, node_length);
+                strings_pool[node_length] = '\0';
+                new_node->signature = strings_pool;
+                strings_pool += node_length + 1;
+
+                switch (node->type) {
+                        case 'a': {
+                                // "a{sv}" -> "{sv}"
+                                new_node->contents = new_node->signature + 1;
+                                break;
+                        }
+                        case 'r':
+                        case 'e': {
+                                // "(sa{sv})" -> "sa{sv}"
+                                memcpy(strings_pool, signature + node->start + 1, node_length - 2);
+                                strings_pool[node_length - 2] = '\0';
+                                new_node->contents = strings_pool;
+                                strings_pool += node_length - 1;
+                                break;
+                        }
+                        default: {
+                                new_node->contents = NULL;
+                                break;
+                        }
+                }
+        }
+
+        PyObject* new_capsule = PyCapsule_New(new_plan, SD_BUS_PY_SIGNATURE_PLAN_CAPSULE_NAME, _SdBusSignaturePlan_capsule_destructor);
+        if (new_capsule == NULL) {
+                PyMem_Free(new_plan);
+                return NULL;
+        }
+        return new_capsule;
+}
+
+PyObject* _SdBusSignaturePlan_get(PyObject* signature_str) {
+        PyObject* cached_capsule = PyDict_GetItemWithError(signature_plan_cache, signature_str);
+        if (cached_capsule != NULL) {
+                Py_INCREF(cached_capsule);
+                return cached_capsule;
+        }
+        PYTHON_ERR_OCCURED;
+
+        if (!PyUnicode_Check(signature_str)) {
+                PyErr_Format(PyExc_TypeError, "Expected signature str, got %R", signature_str);
+                return NULL;
+        }
+#ifdef SD_BUS_PY_HAS_UNICODE_AS_UTF8
+        const char* signature_char_ptr = SD_BUS_PY_UNICODE_AS_CHAR_PTR(signature_str);
+#else
+        PyObject* signature_bytes CLEANUP_PY_OBJECT = SD_BUS_PY_UNICODE_AS_BYTES(signature_str);
+        const char* signature_char_ptr = SD_BUS_PY_BYTES_AS_CHAR_PTR(signature_bytes);
+#endif
+        PyObject* new_capsule CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(_SdBusSignaturePlan_compile(signature_char_ptr));
+
+        // Signatures of variants come from the remote peers.
+        // Do not let them grow the cache without a bound.
+        if (PyDict_Size(signature_plan_cache) >= SD_BUS_PY_SIGNATURE_CACHE_MAX_SIZE) {
+                PyDict_Clear(signature_plan_cache);
+        }
+        CALL_PYTHON_INT_CHECK(PyDict_SetItem(signature_plan_cache, signature_str, new_capsule));
+
+        Py_INCREF(new_capsule);
+        return new_capsule;
+}
+
+PyObject* _SdBusSignaturePlan_get_from_char_ptr(const char* signature_char_ptr) {
+        PyObject* signature_str CLEANUP_PY_OBJECT = CALL_PYTHON_AND_CHECK(PyUnicode_FromString(signature_char_ptr));
+        return _SdBusSignaturePlan_get(signature_str);
+}
+
+const SdBusSignaturePlan* _SdBusSignaturePlan_from_capsule(PyObject* plan_capsule) {
+        return PyCapsule_GetPointer(plan_capsule, SD_BUS_PY_SIGNATURE_PLAN_CAPSULE_NAME);
+}
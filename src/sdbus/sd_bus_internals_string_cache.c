@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+    Copyright (C) 2020, 2021 igo95862
+
+    This file is part of python-sdbus
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+#include "sd_bus_internals.h"
+
+// String cache
+//
+// Direct mapped table of recently decoded strings. Dict keys, member names
+// and object paths repeat a lot so the same str object can be returned
+// instead of decoding and allocating a new one every time.
+// Colliding strings replace the older entry so the size is always bounded.
+
+typedef struct {
+        uint64_t hash;
+        size_t length;
+        char* utf8;
+        PyObject* str;
+} _String_cache_entry;
+
+static _String_cache_entry* string_cache_entries = NULL;
+static size_t string_cache_size = 0;
+static size_t string_cache_hits = 0;
+static size_t string_cache_misses = 0;
+static size_t string_cache_evictions = 0;
+
+static void _string_cache_entry_clear(_String_cache_entry* entry) {
+        Py_XDECREF(entry->str);
+        PyMem_Free(entry->utf8);
+        entry->str = NULL;
+        entry->utf8 = NULL;
+}
+
+PyObject* _SdBusStringCache_get(const char* string) {
+        if (string_cache_size == 0) {
+                return PyUnicode_FromString(string);
+        }
+
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        size_t length = 0;
+        for (; string[length] != '\0'; ++length) {
+                if (length == SD_BUS_PY_STRING_CACHE_MAX_LENGTH) {
+                        return PyUnicode_FromString(string);
+                }
+                hash = (hash ^ (uint8_t)string[length]) * 1099511628211ULL;
+        }
+
+        _String_cache_entry* entry = &string_cache_entries[hash & (string_cache_size - 1)];
+        if (entry->str != NULL && entry->hash == hash && entry->length == length && memcmp(entry->utf8, string, length) == 0) {
+                string_cache_hits++;
+                Py_INCREF(entry->str);
+                return entry->str;
+        }
+        string_cache_misses++;
+
+        PyObject* new_str = CALL_PYTHON_AND_CHECK(PyUnicode_FromStringAndSize(string, (Py_ssize_t)length));
+        char* new_utf8 = PyMem_Malloc(length > 0 ? length : 1);
+        if (new_utf8 == NULL) {
+                // Not caching is fine
+                return new_str;
+        }
+        if (entry->str != NULL) {
+                string_cache_evictions++;
+                _string_cache_entry_clear(entry);
+        }
+        memcpy(new_utf8, string, length);
+        entry->hash = hash;
+        entry->length = length;
+        entry->utf8 = new_utf8;
+        Py_INCREF(new_str);
+        entry->str = new_str;
+        return new_str;
+}
+
+PyObject* _SdBusStringCache_set_size(size_t new_size) {
+        // Rounded up to the power of two. Zero disables the cache.
+        // Clears the cache and the stats.
+        size_t rounded_size = 0;
+        if (new_size > 0) {
+                rounded_size = 1;
+                while (rounded_size < new_size) {
+                        if (rounded_size > (SIZE_MAX / sizeof(_String_cache_entry)) / 2) {
+                                return PyErr_NoMemory();
+                        }
+                        rounded_size *= 2;
+                }
+        }
+
+        _String_cache_entry* new_entries = NULL;
+        if (rounded_size > 0) {
+                new_entries = PyMem_Calloc(rounded_size, sizeof(_String_cache_entry));
+                if (new_entries == NULL) {
+                        return PyErr_NoMemory();
+                }
+        }
+
+        for (size_t i = 0; i < string_cache_size; ++i) {
+                _string_cache_entry_clear(&string_cache_entries[i]);
+        }
+        PyMem_Free(string_cache_entries);
+        string_cache_entries = new_entries;
+        string_cache_size = rounded_size;
+        string_cache_hits = 0;
+        string_cache_misses = 0;
+        string_cache_evictions = 0;
+        Py_RETURN_NONE;
+}
+
+PyObject* _SdBusStringCache_get_stats(void) {
+        size_t used_entries = 0;
+        for (size_t i = 0; i < string_cache_size; ++i) {
+                used_entries += string_cache_entries[i].str != NULL;
+        }
+        return Py_BuildValue("{snsnsnsnsn}", "size", (Py_ssize_t)string_cache_size, "used", (Py_ssize_t)used_entries, "hits",
+                             (Py_ssize_t)string_cache_hits, "misses", (Py_ssize_t)string_cache_misses, "evictions", (Py_ssize_t)string_cache_evictions);
+}
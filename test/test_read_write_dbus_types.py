@@ -19,13 +19,45 @@
 # Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
 from __future__ import annotations
 
-from typing import Dict, List
+from array import array
+from collections.abc import Mapping, Sequence
+from dataclasses import dataclass
+from os import close, pipe
+from typing import Dict, List, NamedTuple
 from unittest import main
 
 from sdbus.sd_bus_internals import SdBus, SdBusMessage
 from sdbus.unittest import IsolatedDbusTestCase
 
-from sdbus import SdBusLibraryError
+from sdbus import (
+    DbusDecodeColumnsFlag,
+    DbusDecodeLazyFlag,
+    DbusDecodeMemfdFlag,
+    DbusDecodeMemoryViewFlag,
+    DbusDecodeTypedArraysFlag,
+    DbusDecodeUnwrapVariantsFlag,
+    DbusEncodeInferVariantsFlag,
+    DbusLimitsExceededError,
+    SdBusLibraryError,
+    SealedMemfd,
+    get_string_cache_stats,
+    register_struct_type,
+    set_signature_decode_flags,
+    set_signature_encode_flags,
+    set_string_cache_size,
+    set_variant_int_signature,
+)
+
+
+class StructUnit(NamedTuple):
+    name: str
+    pid: int
+
+
+@dataclass
+class StructJob:
+    job_id: int
+    unit: StructUnit
 
 
 def create_message(bus: SdBus) -> SdBusMessage:
@@ -168,6 +200,517 @@ class TestDbusTypes(IsolatedDbusTestCase):
             message.get_contents(),
             (test_string_array, test_bytes_array, test_int_list, []))
 
+    def test_array_from_buffer(self) -> None:
+        message = create_message(self.bus)
+
+        test_doubles = [0.5, -1.25, 1e100, 3.0]
+        test_ints = [-5, 0, 2**31 - 1]
+        test_uint64s = [0, 2**64 - 1]
+        test_shorts = [-(2**15), 2**15 - 1]
+
+        message.append_data("ad", array("d", test_doubles))
+        message.append_data("ai", memoryview(array("i", test_ints)))
+        message.append_data("at", array("Q", test_uint64s))
+        message.append_data("an", array("h", test_shorts))
+        message.append_data("ay", memoryview(b"buffer"))
+        message.append_data("ad", array("d"))
+
+        self.assertRaises(TypeError, message.append_data,
+                          "ad", array("f", [1.0]))
+        self.assertRaises(TypeError, message.append_data,
+                          "ai", array("I", [1]))
+        self.assertRaises(TypeError, message.append_data,
+                          "ax", array("i", [1]))
+
+        message.seal()
+
+        self.assertEqual(
+            message.get_contents(),
+            (test_doubles, test_ints, test_uint64s, test_shorts,
+             b"buffer", []))
+
+    def test_array_from_iterable(self) -> None:
+        message = create_message(self.bus)
+
+        test_strings = ["Ttest", "serawer", "asdadcxzc"]
+        test_structs = [("/a", 1), ("/b", 2)]
+
+        message.append_data("as", tuple(test_strings))
+        message.append_data("as", (x for x in test_strings))
+        message.append_data("ai", range(3))
+        message.append_data("as", {"key": 1}.keys())
+        message.append_data("a(oi)", iter(test_structs))
+        message.append_data("aai", ((x, x) for x in range(2)))
+        message.append_data("ax", iter(()))
+
+        self.assertRaises(TypeError, message.append_data, "as", "string")
+        self.assertRaises(TypeError, message.append_data, "ai", {1: 2})
+        self.assertRaises(TypeError, message.append_data, "ai", 1)
+
+        def failing_generator():  # type: ignore
+            yield 1
+            raise ValueError
+
+        self.assertRaises(ValueError, message.append_data,
+                          "ai", failing_generator())
+
+        message = create_message(self.bus)
+        message.append_data("as", (x for x in test_strings))
+        message.append_data("a(oi)", iter(test_structs))
+        message.append_data("aai", ((x, x) for x in range(2)))
+        message.append_data("ai", range(3))
+        message.seal()
+
+        self.assertEqual(
+            message.get_contents(),
+            (test_strings, test_structs, [[0, 0], [1, 1]], [0, 1, 2]))
+
+    def test_typed_array_decode(self) -> None:
+        message = create_message(self.bus)
+
+        test_doubles = [0.5, -1.25, 1e100]
+        test_uint32s = [0, 2**32 - 1]
+        test_int64s = [-(2**63), 2**63 - 1]
+
+        message.append_data("adauaxasa(i)", test_doubles, test_uint32s,
+                            test_int64s, ["test"], [(1, )])
+        message.append_data("v", ("an", [-1, 1]))
+        message.append_data("aq", [])
+        message.seal()
+
+        (
+            doubles, uint32s, int64s, strings, structs, variant, empty_array
+        ) = message.get_contents(DbusDecodeTypedArraysFlag)
+
+        self.assertEqual(doubles, array("d", test_doubles))
+        self.assertEqual(uint32s, array("I", test_uint32s))
+        self.assertEqual(int64s, array("q", test_int64s))
+        self.assertEqual(strings, ["test"])
+        self.assertEqual(structs, [(1, )])
+        self.assertEqual(variant, ("an", array("h", [-1, 1])))
+        self.assertEqual(empty_array, array("H"))
+
+        # Default decoding still returns lists
+        message = create_message(self.bus)
+        message.append_data("ad", test_doubles)
+        message.seal()
+        self.assertIsInstance(message.get_contents(), list)
+
+    def test_typed_array_signature_flags(self) -> None:
+        set_signature_decode_flags("at", DbusDecodeTypedArraysFlag)
+        try:
+            message = create_message(self.bus)
+            message.append_data("at", [1, 2, 3])
+            message.seal()
+
+            self.assertEqual(message.get_contents(), array("Q", [1, 2, 3]))
+
+            message = create_message(self.bus)
+            message.append_data("at", [1, 2, 3])
+            message.seal()
+
+            self.assertEqual(message.get_contents(0), array("Q", [1, 2, 3]))
+        finally:
+            set_signature_decode_flags("at", 0)
+
+        # Explicit flags are combined with the registered ones
+        set_signature_decode_flags("vat", DbusDecodeTypedArraysFlag)
+        try:
+            message = create_message(self.bus)
+            message.append_data("vat", ("s", "test"), [1, 2, 3])
+            message.seal()
+
+            self.assertEqual(
+                message.get_contents(DbusDecodeUnwrapVariantsFlag),
+                ("test", array("Q", [1, 2, 3])),
+            )
+        finally:
+            set_signature_decode_flags("vat", 0)
+
+        message = create_message(self.bus)
+        message.append_data("at", [1, 2, 3])
+        message.seal()
+        self.assertEqual(message.get_contents(), [1, 2, 3])
+
+        self.assertRaises(TypeError, set_signature_decode_flags,
+                          "a{", DbusDecodeTypedArraysFlag)
+
+    def test_bytes_memory_view_decode(self) -> None:
+        message = create_message(self.bus)
+
+        test_bytes = b"memory\0view" * 100
+        message.append_data("ayayay", test_bytes, b"", b"second")
+        message.seal()
+
+        first, empty, second = message.get_contents(DbusDecodeMemoryViewFlag)
+        del message
+
+        if isinstance(first, bytes):
+            # Limited API before 3.11 has no buffer protocol
+            self.assertEqual(first, test_bytes)
+            return
+
+        self.assertIsInstance(first, memoryview)
+        self.assertTrue(first.readonly)
+        self.assertEqual(first, test_bytes)
+        self.assertEqual(bytes(empty), b"")
+        self.assertEqual(second.tobytes(), b"second")
+
+    def test_lazy_decode(self) -> None:
+        test_objects = {
+            f"/object{i}": {
+                "org.example.Interface": {
+                    "Id": ("u", i),
+                    "Tags": ("as", ["a", str(i)]),
+                },
+            }
+            for i in range(100)
+        }
+        test_list = [("name", [1, 2]), ("other", [3])]
+
+        def create_test_message() -> SdBusMessage:
+            message = create_message(self.bus)
+            message.append_data(
+                "a{oa{sa{sv}}}sa(sai)", test_objects, "test", test_list)
+            message.seal()
+            return message
+
+        objects, test_str, lazy_list = create_test_message().get_contents(
+            DbusDecodeLazyFlag)
+
+        self.assertIsInstance(objects, Mapping)
+        self.assertIsInstance(lazy_list, Sequence)
+        self.assertEqual(test_str, "test")
+
+        self.assertEqual(
+            objects["/object50"]["org.example.Interface"]["Id"], ("u", 50))
+        self.assertIs(objects["/object50"], objects["/object50"])
+        self.assertEqual(
+            objects["/object7"],
+            test_objects["/object7"],
+        )
+        self.assertIn("/object99", objects)
+        self.assertNotIn("/object100", objects)
+        self.assertIsNone(objects.get("/object100"))
+        self.assertRaises(KeyError, objects.__getitem__, "/object100")
+        self.assertEqual(len(objects), 100)
+        self.assertEqual(list(objects.keys()), list(test_objects.keys()))
+
+        # Sequence is decoded in order
+        self.assertEqual(lazy_list[-1], test_list[-1])
+        self.assertEqual(lazy_list[0:1], test_list[0:1])
+        self.assertEqual(lazy_list, test_list)
+        self.assertEqual(lazy_list.index(test_list[1]), 1)
+        self.assertEqual(lazy_list.count(test_list[0]), 1)
+        self.assertRaises(IndexError, lazy_list.__getitem__, 2)
+
+        self.assertEqual(objects, test_objects)
+        self.assertEqual(dict(objects.items()), test_objects)
+
+        self.assertEqual(
+            create_test_message().get_contents(DbusDecodeLazyFlag),
+            (test_objects, "test", test_list),
+        )
+
+    def test_lazy_decode_after_cursor_move(self) -> None:
+        test_list = [("a", 1), ("b", 2), ("c", 3)]
+
+        message = create_message(self.bus)
+        message.append_data("a(si)ay", test_list, b"data")
+        message.seal()
+
+        lazy_list, _ = message.get_contents(DbusDecodeLazyFlag)
+        self.assertEqual(lazy_list[0], test_list[0])
+
+        # Moving the message position invalidates the lazy cursor
+        message.enter_container("r", "si")
+        self.assertEqual(lazy_list[1], test_list[1])
+        self.assertEqual(lazy_list[2], test_list[2])
+
+        # Lazy decode starts from the beginning after a partial read
+        test_dict = {"a": ["b", "c"], "d": []}
+        message = create_message(self.bus)
+        message.append_data("a{sas}", test_dict)
+        message.seal()
+        message.set_decode_limits(0, 1, 0, 0)
+        self.assertRaises(DbusLimitsExceededError, message.get_contents)
+
+        message.set_decode_limits(0, 0, 0, 0)
+        lazy_dict = message.get_contents(DbusDecodeLazyFlag)
+        self.assertEqual(
+            {key: list(value) for key, value in lazy_dict.items()},
+            test_dict,
+        )
+
+    def test_projection(self) -> None:
+        test_properties = {
+            "Id": ("s", "test"),
+            "State": ("u", 1),
+            "Tags": ("as", ["a", "b"]),
+            "Nested": ("a{sv}", {"Inner": ("b", True), "Other": ("i", 2)}),
+        }
+        test_structs = [("a", 1, ["x"], 1.5), ("b", 2, ["y"], 2.5)]
+
+        def create_test_message() -> SdBusMessage:
+            message = create_message(self.bus)
+            message.append_data(
+                "sa{sv}a(siasd)as",
+                "org.example", test_properties, test_structs, ["inv"])
+            message.seal()
+            return message
+
+        self.assertEqual(
+            create_test_message().get_contents(
+                None, {1: {"Id", "State"}}),
+            (None, {"Id": ("s", "test"), "State": ("u", 1)}, None, None),
+        )
+        self.assertEqual(
+            create_test_message().get_contents(
+                None, {1: {"Nested": ["Inner"]}, 2: (0, 3), 3: None}),
+            (
+                None,
+                {"Nested": ("a{sv}", {"Inner": ("b", True)})},
+                [("a", None, None, 1.5), ("b", None, None, 2.5)],
+                ["inv"],
+            ),
+        )
+        self.assertEqual(
+            create_test_message().get_contents(None, [0, 2]),
+            ("org.example", None, test_structs, None),
+        )
+
+        self.assertEqual(
+            create_test_message().get_contents(
+                DbusDecodeUnwrapVariantsFlag,
+                {1: {"State": None, "Nested": ["Inner"]}}),
+            (None, {"State": 1, "Nested": {"Inner": ("b", True)}}, None, None),
+        )
+
+        self.assertRaises(
+            TypeError, create_test_message().get_contents, None, 1)
+        self.assertRaises(
+            ValueError, create_test_message().get_contents,
+            DbusDecodeLazyFlag, [0])
+
+    def test_iter_array(self) -> None:
+        test_units = [
+            (f"unit{i}.service", "loaded", f"/unit/{i}", i)
+            for i in range(1000)
+        ]
+        test_dict = {"a": ("u", 1), "b": ("as", ["c"])}
+
+        message = create_message(self.bus)
+        message.append_data("a(ssou)a{sv}", test_units, test_dict)
+        message.append_data("ad", [1.0, 2.0])
+        message.seal()
+
+        units_iter = message.iter_array()
+        self.assertEqual(next(units_iter), test_units[0])
+        self.assertEqual(list(units_iter), test_units[1:])
+        self.assertEqual(list(units_iter), [])
+
+        self.assertEqual(dict(message.iter_array()), test_dict)
+        self.assertEqual(
+            list(message.iter_array(DbusDecodeTypedArraysFlag)),
+            [1.0, 2.0])
+        self.assertRaises(TypeError, message.iter_array)
+
+        message = create_message(self.bus)
+        message.append_data("sas", "test", ["a"])
+        message.seal()
+        self.assertRaises(TypeError, message.iter_array)
+
+    def test_string_cache(self) -> None:
+        long_string = "long" * 100
+
+        def decode_test_message() -> Dict[str, str]:
+            message = create_message(self.bus)
+            message.append_data(
+                "a{ss}", {"first_key": "value", "long": long_string})
+            message.seal()
+            contents = message.get_contents()
+            assert isinstance(contents, dict)
+            return contents
+
+        try:
+            set_string_cache_size(100)
+            self.assertEqual(get_string_cache_stats()["size"], 128)
+
+            first_dict = decode_test_message()
+            second_dict = decode_test_message()
+            self.assertEqual(first_dict, second_dict)
+            self.assertIs(
+                next(iter(first_dict)), next(iter(second_dict)))
+            self.assertIsNot(first_dict["long"], second_dict["long"])
+
+            stats = get_string_cache_stats()
+            self.assertGreaterEqual(stats["hits"], 3)
+            self.assertGreaterEqual(stats["used"], 3)
+
+            set_string_cache_size(0)
+            self.assertIsNot(
+                next(iter(decode_test_message())),
+                next(iter(decode_test_message())),
+            )
+            self.assertEqual(get_string_cache_stats()["hits"], 0)
+        finally:
+            set_string_cache_size(1024)
+
+    def test_string_arrays_and_dicts(self) -> None:
+        message = create_message(self.bus)
+
+        test_strings = ["a", "", "ünïcode"]
+        test_paths = ["/", "/org/example"]
+        test_signatures = ["s", "a{sv}"]
+        test_managed_objects = {
+            "/org/example": {"org.example": {"Id": ("u", 1)}},
+            "/": {},
+        }
+        test_dict = {"a": 1, "b": 2}
+        test_str_dict = {"a": "/", "b": "/a"}
+
+        message.append_data(
+            "asaoaga{oa{sa{sv}}}a{su}a{so}as",
+            test_strings, test_paths, test_signatures,
+            test_managed_objects, test_dict, test_str_dict, [])
+        message.seal()
+
+        self.assertEqual(
+            message.get_contents(),
+            (test_strings, test_paths, test_signatures,
+             test_managed_objects, test_dict, test_str_dict, []))
+
+    def test_string_array_append(self) -> None:
+        message = create_message(self.bus)
+
+        test_strings = [f"string{i}" for i in range(1000)] + ["", "ü"]
+        test_paths = tuple(f"/org/example/{i}" for i in range(1000))
+
+        message.append_data("as", test_strings)
+        message.append_data("ao", test_paths)
+        message.append_data("ag", ("s", "a{sv}"))
+
+        self.assertRaises(
+            ValueError, create_message(self.bus).append_data,
+            "as", ["a\0b"])
+        self.assertRaises(
+            TypeError, create_message(self.bus).append_data,
+            "as", ["a", 1])
+        self.assertRaises(
+            SdBusLibraryError, create_message(self.bus).append_data,
+            "ao", ["not path"])
+
+        message = create_message(self.bus)
+        message.append_data("asaoag", test_strings, test_paths, ("s",))
+        message.seal()
+
+        self.assertEqual(
+            message.get_contents(),
+            (test_strings, list(test_paths), ["s"]))
+
+    def test_struct_types(self) -> None:
+        test_units = [StructUnit("dbus.service", 10),
+                      StructUnit("sshd.service", 20)]
+        test_job = StructJob(5, StructUnit("cron.service", 30))
+
+        message = create_message(self.bus)
+        message.append_data("a(su)(x(su))", test_units, test_job)
+        message.seal()
+        self.assertEqual(
+            message.get_contents(),
+            ([("dbus.service", 10), ("sshd.service", 20)],
+             (5, ("cron.service", 30))))
+
+        register_struct_type("(su)", StructUnit)
+        register_struct_type("(x(su))", StructJob)
+        try:
+            message = create_message(self.bus)
+            message.append_data("a(su)(x(su))", test_units, test_job)
+            message.seal()
+
+            units, job = message.get_contents()
+            self.assertIsInstance(units[0], StructUnit)
+            self.assertEqual(units, test_units)
+            self.assertIsInstance(job, StructJob)
+            self.assertEqual(job, test_job)
+
+            # Projected structs keep the type only with every field selected
+            message = create_message(self.bus)
+            message.append_data("a(su)(x(su))", test_units, test_job)
+            message.seal()
+
+            units, job = message.get_contents(
+                None, {0: [0, 1], 1: {0: None, 1: [0]}})
+            self.assertIsInstance(units[0], StructUnit)
+            self.assertEqual(units, test_units)
+            self.assertIsInstance(job, StructJob)
+            self.assertNotIsInstance(job.unit, StructUnit)
+            self.assertEqual(job.unit, ("cron.service", None))
+        finally:
+            register_struct_type("(su)", None)
+            register_struct_type("(x(su))", None)
+
+        message = create_message(self.bus)
+        message.append_data("(su)(us)", ("a", 1), (2, "b"))
+        message.seal()
+        self.assertEqual(
+            message.get_contents(None, None, {"(su)": StructUnit}),
+            (StructUnit("a", 1), (2, "b")))
+
+        message = create_message(self.bus)
+        message.append_data("(su)(us)", ("a", 1), (2, "b"))
+        message.seal()
+        self.assertEqual(
+            message.get_contents(None, {0: {0: None, 1: None}},
+                                 {"(su)": StructUnit}),
+            (StructUnit("a", 1), None))
+
+        self.assertRaises(
+            TypeError, register_struct_type, "(sus)", StructUnit)
+        self.assertRaises(
+            TypeError, register_struct_type, "su", StructUnit)
+        self.assertRaises(
+            TypeError, register_struct_type, "(su)", dict)
+        self.assertRaises(
+            TypeError, create_message(self.bus).append_data,
+            "(xs)", test_job)
+        self.assertRaises(
+            TypeError, create_message(self.bus).append_data,
+            "(su)", ["a", 1])
+
+    def test_memfd(self) -> None:
+        message = create_message(self.bus)
+        message.append_data("h", SealedMemfd(b"data"))
+        message.seal()
+        self.assertEqual(message.get_contents(DbusDecodeMemfdFlag), b"data")
+
+        read_fd, write_fd = pipe()
+        try:
+            message = create_message(self.bus)
+            message.append_data("h", read_fd)
+            message.seal()
+        finally:
+            close(read_fd)
+            close(write_fd)
+
+        # Only sealed memfds can be mapped
+        self.assertRaises(
+            TypeError, message.get_contents, DbusDecodeMemfdFlag)
+
+    def test_read_bytes_into(self) -> None:
+        message = create_message(self.bus)
+
+        message.append_data("ayay", b"firmware", b"too large")
+        message.seal()
+
+        buffer = bytearray(8)
+        self.assertEqual(message.read_bytes_into(buffer), 8)
+        self.assertEqual(buffer, b"firmware")
+
+        self.assertRaises(ValueError, message.read_bytes_into, buffer)
+
+        self.assertRaises(BufferError, message.read_bytes_into, b"read only")
+
     def test_empty_array(self) -> None:
         message = create_message(self.bus)
 
@@ -295,6 +838,334 @@ class TestDbusTypes(IsolatedDbusTestCase):
             ]
         )
 
+    def test_unwrap_variants(self) -> None:
+        message = create_message(self.bus)
+
+        test_properties = {
+            'Name': ('s', 'test'),
+            'Pids': ('au', [1, 2, 3]),
+            'Nested': ('v', ('x', 10)),
+            'Options': ('a{sv}', {'Enabled': ('b', True)}),
+        }
+        message.append_data("a{sv}v", test_properties, ('s', 'single'))
+        message.seal()
+
+        self.assertEqual(
+            message.get_contents(DbusDecodeUnwrapVariantsFlag),
+            (
+                {
+                    'Name': 'test',
+                    'Pids': [1, 2, 3],
+                    'Nested': ('x', 10),
+                    'Options': {'Enabled': ('b', True)},
+                },
+                'single',
+            )
+        )
+
+    def test_decode_columns(self) -> None:
+        message = create_message(self.bus)
+
+        test_units = [
+            ('a.service', 'active', '/a', 1, -2, 0.5, True, 255),
+            ('b.service', 'active', '/b', 2, 2 ** 40, -1.0, False, 0),
+        ]
+        test_nested = {'x': [(1, ('s', 'v'))]}
+        message.append_data("a(ssoixdby)a(ss)a{sa(iv)}",
+                            test_units, [], test_nested)
+        message.seal()
+
+        units_columns, empty_columns, nested_dict = message.get_contents(
+            DbusDecodeColumnsFlag)
+        names, states, paths, ids, sizes, weights, enabled, levels = (
+            units_columns)
+        self.assertEqual(names, ['a.service', 'b.service'])
+        self.assertIs(states[0], states[1])
+        self.assertEqual(paths, ['/a', '/b'])
+        self.assertEqual(ids, array('i', [1, 2]))
+        self.assertEqual(sizes, array('q', [-2, 2 ** 40]))
+        self.assertEqual(weights, array('d', [0.5, -1.0]))
+        self.assertEqual(enabled, [True, False])
+        self.assertEqual(levels, array('B', [255, 0]))
+
+        self.assertEqual(empty_columns, ([], []))
+        # Structs with variants are decoded as usual
+        self.assertEqual(nested_dict, test_nested)
+
+        lazy_columns = message.get_contents(
+            DbusDecodeLazyFlag | DbusDecodeColumnsFlag)
+        self.assertEqual(lazy_columns[0][3], array('i', [1, 2]))
+
+    def test_decode_limits(self) -> None:
+        def create_limited_message(
+                max_depth: int = 0,
+                max_elements: int = 0,
+                max_string_bytes: int = 0,
+                max_objects: int = 0) -> SdBusMessage:
+            message = create_message(self.bus)
+            message.append_data(
+                "a{sv}ay",
+                {
+                    'Name': ('s', 'test'),
+                    'Nested': ('v', ('(ii)', (1, 2))),
+                },
+                b'data',
+            )
+            message.seal()
+            message.set_decode_limits(
+                max_depth, max_elements, max_string_bytes, max_objects)
+            return message
+
+        expected = (
+            {
+                'Name': ('s', 'test'),
+                'Nested': ('v', ('(ii)', (1, 2))),
+            },
+            b'data',
+        )
+
+        # Projection selecting everything is charged the same
+        projection = {0: {'Name': None, 'Nested': None}, 1: None}
+
+        self.assertEqual(
+            create_limited_message(4, 2, 18, 20).get_contents(),
+            expected,
+        )
+        self.assertEqual(
+            create_limited_message(4, 2, 18, 11).get_contents(
+                None, projection),
+            expected,
+        )
+
+        for limits in (
+            (3, 0, 0, 0),
+            (0, 1, 0, 0),
+            (0, 0, 17, 0),
+            (0, 0, 0, 10),
+        ):
+            with self.subTest(limits=limits):
+                self.assertRaises(
+                    DbusLimitsExceededError,
+                    create_limited_message(*limits).get_contents,
+                )
+                self.assertRaises(
+                    DbusLimitsExceededError,
+                    create_limited_message(*limits).get_contents,
+                    None, projection,
+                )
+
+        # Lazy views and iterators share the budget of the decode
+        def create_limited_array(*limits: int) -> SdBusMessage:
+            message = create_message(self.bus)
+            message.append_data(
+                "a{sas}",
+                {f"key{i}": ["value"] for i in range(100)},
+            )
+            message.seal()
+            message.set_decode_limits(*limits)
+            return message
+
+        for limits in (
+            (1, 0, 0, 0),
+            (0, 150, 0, 0),
+            (0, 0, 500, 0),
+            (0, 0, 0, 250),
+        ):
+            with self.subTest(limits=limits):
+                self.assertRaises(
+                    DbusLimitsExceededError,
+                    create_limited_array(*limits).get_contents,
+                )
+
+                def read_lazy(message: SdBusMessage) -> None:
+                    lazy_dict = message.get_contents(DbusDecodeLazyFlag)
+                    for value in lazy_dict.values():
+                        list(value)
+
+                self.assertRaises(
+                    DbusLimitsExceededError,
+                    read_lazy,
+                    create_limited_array(*limits),
+                )
+                self.assertRaises(
+                    DbusLimitsExceededError,
+                    list,
+                    create_limited_array(*limits).iter_array(),
+                )
+
+        self.assertEqual(
+            len(create_limited_array(2, 200, 1000, 400).get_contents()),
+            100,
+        )
+
+    def test_json(self) -> None:
+        signature = "sa{sv}aya(ub)a{qd}d"
+        test_data = (
+            'test "quoted"\n',
+            {
+                'Name': ('s', 'test'),
+                'Nested': ('v', ('(ds)', (0.5, 'a'))),
+            },
+            b'\x00\xffdata',
+            [(1, True), (2, False)],
+            {5: 1.0},
+            float('inf'),
+        )
+        message = create_message(self.bus)
+        message.append_data(signature, *test_data)
+        message.seal()
+
+        expected_json = (
+            '["test \\"quoted\\"\\n",'
+            '{"Name":["s","test"],"Nested":["v",["(ds)",[0.5,"a"]]]},'
+            '"AP9kYXRh",'
+            '[[1,true],[2,false]],'
+            '{"5":1.0},'
+            'null]'
+        ).encode()
+        json_data = message.get_contents_json()
+        self.assertEqual(json_data, expected_json)
+        # Position is rewound before writing
+        self.assertEqual(message.get_contents_json(), expected_json)
+
+        replayed_message = create_message(self.bus)
+        replayed_message.append_data_json(signature, json_data)
+        replayed_message.seal()
+        self.assertEqual(replayed_message.get_contents_json(), expected_json)
+
+        string_message = create_message(self.bus)
+        string_message.append_data_json('s', '"\\u00e9\\ud83d\\ude00"')
+        string_message.seal()
+        self.assertEqual(string_message.get_contents(), '\u00e9\U0001f600')
+
+        for bad_signature, bad_json in (
+            ('ai', '[1'),
+            ('ai', '[1, "a"]'),
+            ('y', '256'),
+            ('(is)', '[1]'),
+            ('ay', '"abc"'),
+            ('s', '"a\\u0000"'),
+            ('s', '"a" 1'),
+        ):
+            with self.subTest(signature=bad_signature, json=bad_json):
+                self.assertRaises(
+                    (ValueError, OverflowError),
+                    create_message(self.bus).append_data_json,
+                    bad_signature, bad_json,
+                )
+
+    def test_infer_variants(self) -> None:
+        test_properties = {
+            'Name': 'test',
+            'Enabled': True,
+            'Count': 10,
+            'Ratio': 0.5,
+            'Data': b'data',
+            'Pids': [1, 2, 3],
+            'Mixed': [1, 'a'],
+            'Empty': [],
+            'Options': {'Enabled': False},
+            'Explicit': ('u', 5),
+        }
+
+        self.assertRaises(
+            TypeError, create_message(self.bus).append_data,
+            "a{sv}", test_properties)
+
+        set_signature_encode_flags('a{sv}', DbusEncodeInferVariantsFlag)
+        try:
+            message = create_message(self.bus)
+            message.append_data("a{sv}", test_properties)
+            message.seal()
+
+            self.assertEqual(
+                message.get_contents(),
+                {
+                    'Name': ('s', 'test'),
+                    'Enabled': ('b', True),
+                    'Count': ('x', 10),
+                    'Ratio': ('d', 0.5),
+                    'Data': ('ay', b'data'),
+                    'Pids': ('ax', [1, 2, 3]),
+                    'Mixed': ('av', [('x', 1), ('s', 'a')]),
+                    'Empty': ('av', []),
+                    'Options': ('a{sb}', {'Enabled': False}),
+                    'Explicit': ('u', 5),
+                }
+            )
+
+            shared_list = [1, 'x']
+            nested_properties = {
+                'Nested': {
+                    'Inner': {'Mixed': shared_list, 'Count': 2},
+                    'Other': 'e',
+                },
+                'Shared': shared_list,
+            }
+            message = create_message(self.bus)
+            message.append_data("a{sv}", nested_properties)
+            message.seal()
+
+            inferred_mixed = ('av', [('x', 1), ('s', 'x')])
+            self.assertEqual(
+                message.get_contents(),
+                {
+                    'Nested': ('a{sv}', {
+                        'Inner': ('a{sv}', {
+                            'Mixed': inferred_mixed,
+                            'Count': ('x', 2),
+                        }),
+                        'Other': ('s', 'e'),
+                    }),
+                    'Shared': inferred_mixed,
+                }
+            )
+
+            set_variant_int_signature('u')
+            message = create_message(self.bus)
+            message.append_data("a{sv}", {'Count': 10})
+            message.seal()
+            self.assertEqual(message.get_contents(), {'Count': ('u', 10)})
+
+            self.assertRaises(
+                TypeError, create_message(self.bus).append_data,
+                "a{sv}", {'Bad': object()})
+            self.assertRaises(
+                TypeError, create_message(self.bus).append_data,
+                "a{sv}", {'Bad': {1: 'a', 'b': 'c'}})
+            self.assertRaises(ValueError, set_variant_int_signature, 's')
+        finally:
+            set_variant_int_signature('x')
+            set_signature_encode_flags('a{sv}', 0)
+
+    def test_encoded_value(self) -> None:
+        test_capabilities = {'Version': ('u', 2), 'Names': ('as', ['a'])}
+        encoded_capabilities = self.bus.new_encoded_value(
+            "a{sv}", test_capabilities)
+        self.assertEqual(encoded_capabilities.signature, "a{sv}")
+        self.assertEqual(
+            encoded_capabilities.get_contents(), test_capabilities)
+
+        for _ in range(2):
+            message = create_message(self.bus)
+            message.append_data(
+                "sa{sv}a{sv}", "test", encoded_capabilities,
+                {'Nested': encoded_capabilities})
+            message.seal()
+
+            self.assertEqual(
+                message.get_contents(),
+                ("test", test_capabilities,
+                 {'Nested': ("a{sv}", test_capabilities)}))
+
+        self.assertRaises(
+            TypeError, create_message(self.bus).append_data,
+            "a{ss}", encoded_capabilities)
+        self.assertRaises(
+            TypeError, self.bus.new_encoded_value, "ss", ("a", "b"))
+        self.assertRaises(
+            TypeError, self.bus.new_encoded_value, "as", [1])
+
     def test_array_of_dict(self) -> None:
         message = create_message(self.bus)
 
@@ -395,6 +1266,33 @@ class TestDbusTypes(IsolatedDbusTestCase):
             test_array
         )
 
+    def test_invalid_signatures(self) -> None:
+        message = create_message(self.bus)
+
+        self.assertRaises(TypeError, message.append_data, "a{ss", {})
+        self.assertRaises(TypeError, message.append_data, "a{vs}", {})
+        self.assertRaises(TypeError, message.append_data, "()", ())
+        self.assertRaises(TypeError, message.append_data, "(ss", ('a', 'b'))
+        self.assertRaises(TypeError, message.append_data, "(ss)", ('a',))
+        self.assertRaises(TypeError, message.append_data, "v", ('ss', 'a'))
+        self.assertRaises(TypeError, message.append_data, "s", 'a', 'b')
+
+    def test_repeated_signature(self) -> None:
+        test_data = [
+            ('/', {'test': ('s', 'a'), 'nested': ('(sx)', ('b', -2))}),
+            ('/test', {}),
+        ]
+
+        for _ in range(3):
+            message = create_message(self.bus)
+            message.append_data("a(oa{sv})v", test_data, ('a(ii)', [(1, 2)]))
+            message.seal()
+
+            self.assertEqual(
+                message.get_contents(),
+                (test_data, ('a(ii)', [(1, 2)]))
+            )
+
     def test_sealed_message_append(self) -> None:
         message = create_message(self.bus)
 
@@ -20,18 +20,33 @@
 
 from __future__ import annotations
 
-from asyncio import Event, get_running_loop, sleep, wait_for
+from asyncio import (
+    CancelledError,
+    Event,
+    Task,
+    gather,
+    get_running_loop,
+    sleep,
+    wait_for,
+)
 from asyncio.subprocess import create_subprocess_exec
-from typing import Tuple
+from os import kill
+from signal import SIGCONT, SIGSTOP
+from sys import getrefcount
+from typing import Any, Dict, List, NamedTuple, Tuple
 from unittest import SkipTest
 
 from sdbus.dbus_common_funcs import PROPERTY_FLAGS_MASK, count_bits
 from sdbus.sd_bus_internals import (
     DBUS_ERROR_TO_EXCEPTION,
+    DbusDecodeMemfdFlag,
     DbusDeprecatedFlag,
     DbusPropertyConstFlag,
     DbusPropertyEmitsChangeFlag,
+    SdBusMessage,
+    SealedMemfd,
     is_interface_name_valid,
+    set_signature_decode_flags,
 )
 from sdbus.unittest import IsolatedDbusTestCase
 
@@ -39,6 +54,8 @@ from sdbus import (
     DbusFailedError,
     DbusFileExistsError,
     DbusInterfaceCommonAsync,
+    DbusLimitsExceededError,
+    DbusNoReplyError,
     DbusNoReplyFlag,
     DbusUnknownObjectError,
     SdBusLibraryError,
@@ -49,6 +66,7 @@ from sdbus import (
     dbus_property_async_override,
     dbus_signal_async,
     get_current_message,
+    sd_bus_open_user,
 )
 
 
@@ -77,12 +95,119 @@ class TestPing(IsolatedDbusTestCase):
         r = await self.bus.call_async(m)
         self.assertIsNone(r.get_contents())
 
+    async def test_call_async_future(self) -> None:
+        def new_get_id_message() -> SdBusMessage:
+            return self.bus.new_method_call_message(
+                'org.freedesktop.DBus', '/org/freedesktop/DBus',
+                'org.freedesktop.DBus', 'GetId',
+            )
+
+        bus_id = await self.bus.call_async(new_get_id_message(), True)
+        self.assertIsInstance(bus_id, str)
+
+        self.assertEqual(
+            await gather(
+                self.bus.call_async(new_get_id_message(), True),
+                wait_for(
+                    self.bus.call_async(new_get_id_message(), True),
+                    timeout=1,
+                ),
+            ),
+            [bus_id, bus_id],
+        )
+
+        future = self.bus.call_async(new_get_id_message())
+        self.assertFalse(future.done())
+        self.assertTrue(future.cancel())
+        self.assertTrue(future.cancelled())
+        self.assertFalse(future.cancel())
+
 
 class TestRequestName(IsolatedDbusTestCase):
     async def test_request_name(self) -> None:
         await self.bus.request_name_async("org.example.test", 0)
 
 
+class TestDrain(IsolatedDbusTestCase):
+    async def test_drain(self) -> None:
+        await self.bus.request_name_async("org.example.test", 0)
+        await wait_for(self.bus.drain(), timeout=1)
+
+        with open(self.pid_path) as pid_file:
+            dbus_pid = int(pid_file.read())
+
+        # Stop the bus daemon so that the socket buffer fills up
+        kill(dbus_pid, SIGSTOP)
+        try:
+            payload = bytes(2 ** 16)
+            for _ in range(256):
+                signal_message = self.bus.new_signal_message(
+                    '/', 'org.example.test', 'Storm')
+                signal_message.append_data('ay', payload)
+                signal_message.send()
+
+            queued_write = self.bus.n_queued_write
+            self.assertGreater(queued_write, 0)
+
+            await wait_for(
+                self.bus.drain(high_water=queued_write), timeout=1)
+
+            drain_future = self.bus.drain()
+            await sleep(0.05)
+            self.assertFalse(drain_future.done())
+        finally:
+            kill(dbus_pid, SIGCONT)
+
+        await wait_for(drain_future, timeout=5)
+        self.assertEqual(self.bus.n_queued_write, 0)
+
+        with self.assertRaises(OverflowError):
+            self.bus.drain(high_water=-1)
+
+    async def test_drain_close(self) -> None:
+        await self.bus.request_name_async("org.example.test", 0)
+
+        with open(self.pid_path) as pid_file:
+            dbus_pid = int(pid_file.read())
+
+        kill(dbus_pid, SIGSTOP)
+        try:
+            payload = bytes(2 ** 16)
+            for _ in range(256):
+                signal_message = self.bus.new_signal_message(
+                    '/', 'org.example.test', 'Storm')
+                signal_message.append_data('ay', payload)
+                signal_message.send()
+
+            drain_future = self.bus.drain()
+            self.assertFalse(drain_future.done())
+
+            # Queued messages are dropped so the drain can never finish
+            self.bus.close()
+            with self.assertRaises(SdBusLibraryError):
+                await wait_for(drain_future, timeout=1)
+        finally:
+            kill(dbus_pid, SIGCONT)
+
+    async def test_closed_bus_released(self) -> None:
+        bus = sd_bus_open_user()
+        bus_refs = getrefcount(bus)
+
+        await bus.request_name_async("org.example.closed", 0)
+        signal_message = bus.new_signal_message(
+            '/', 'org.example.test', 'Closed')
+        signal_message.send()
+
+        # Loop reader, writer and timer no longer reference the bus
+        bus.close()
+        self.assertEqual(getrefcount(bus), bus_refs)
+
+
+class StructPair(NamedTuple):
+    first: str
+    second: str
+
+
 class TestInterface(DbusInterfaceCommonAsync,
                     interface_name='org.test.test',
                     ):
@@ -94,6 +219,7 @@ class TestInterface(DbusInterfaceCommonAsync,
         self.test_no_reply_string = 'no'
         self.no_reply_sync = Event()
         self.echo_sender_sync = Event()
+        self.slow_reply_sync = Event()
 
     @dbus_method_async("s", "s")
     async def upper(self, string: str) -> str:
@@ -195,14 +321,31 @@ class TestInterface(DbusInterfaceCommonAsync,
     async def test_struct_return_workaround(self) -> Tuple[Tuple[str, str]]:
         return (('hello', 'world'), )
 
+    @dbus_method_async(
+        result_signature='(ss)',
+        result_struct_types=StructPair,
+    )
+    async def struct_pair_return(self) -> StructPair:
+        return StructPair('hello', 'world')
+
     @dbus_method_async()
     async def looong_method(self) -> None:
         await sleep(100)
 
+    @dbus_method_async(result_signature='s')
+    async def slow_method(self) -> str:
+        await sleep(0.3)
+        self.slow_reply_sync.set()
+        return 'done'
+
     @dbus_signal_async()
     def empty_signal(self) -> None:
         raise NotImplementedError
 
+    @dbus_method_async('h', 'h')
+    async def echo_memfd(self, payload: memoryview) -> SealedMemfd:
+        return SealedMemfd(payload.tobytes())
+
 
 class DbusErrorTest(DbusFailedError):
     dbus_error_name = 'org.example.Error'
@@ -266,6 +409,76 @@ class TestProxy(IsolatedDbusTestCase):
             await test_object_connection.kwargs_function(
                 input='ASD', is_upper=False))
 
+    async def test_struct_types(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        reply = await wait_for(
+            test_object_connection.struct_pair_return(), 0.5)
+        self.assertIsInstance(reply, StructPair)
+        self.assertEqual(reply, await test_object.struct_pair_return())
+
+    async def test_decode_limits(self) -> None:
+        test_object, test_object_connection = initialize_object()
+        test_object.set_decode_limits(max_string_bytes=8)
+
+        self.assertEqual(
+            'SHORT',
+            await wait_for(test_object_connection.upper('short'), 0.5),
+        )
+
+        with self.assertRaises(DbusLimitsExceededError):
+            await wait_for(
+                test_object_connection.upper('too long string'), 0.5)
+
+        with self.assertRaises(DbusLimitsExceededError):
+            await wait_for(
+                test_object_connection.test_property.set_async(
+                    'too long string'),
+                0.5,
+            )
+
+        # Limits of the interface override limits of the bus
+        self.bus.set_decode_limits(0, 0, 4, 0)
+        self.assertEqual(
+            'SHORT',
+            await wait_for(test_object_connection.upper('short'), 0.5),
+        )
+
+        test_object.set_decode_limits()
+        with self.assertRaises(DbusLimitsExceededError):
+            await wait_for(test_object_connection.upper('short'), 0.5)
+
+    async def test_memfd_payload(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        test_payload = b"large payload" * 100_000
+
+        set_signature_decode_flags('h', DbusDecodeMemfdFlag)
+        try:
+            reply = await test_object_connection.echo_memfd(
+                SealedMemfd(test_payload))
+            self.assertIsInstance(reply, memoryview)
+            self.assertTrue(reply.readonly)
+            self.assertEqual(reply, test_payload)
+
+            self.assertEqual(
+                await test_object_connection.echo_memfd(SealedMemfd(b"")),
+                b"",
+            )
+
+            # Bare buffers are not file descriptors
+            with self.assertRaises(TypeError):
+                await test_object_connection.echo_memfd(test_payload)
+
+            with self.assertRaises(TypeError):
+                SealedMemfd("not bytes")
+
+            with self.assertRaises(TypeError):
+                await test_object_connection.echo_memfd(
+                    SealedMemfd.__new__(SealedMemfd))
+        finally:
+            set_signature_decode_flags('h', 0)
+
     async def test_method(self) -> None:
         test_object, test_object_connection = initialize_object()
 
@@ -558,6 +771,77 @@ class TestProxy(IsolatedDbusTestCase):
 
         await wait_for(test_object.no_reply_sync.wait(), timeout=1)
 
+    async def test_call_with_timeout(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        self.assertEqual(
+            await test_object_connection.upper.call_with_timeout(
+                1, 'test'),
+            'TEST',
+        )
+
+        with self.assertRaises(ValueError):
+            test_object_connection.upper.call_with_timeout(0, 'test')
+
+    async def test_call_with_timeout_slow_method(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        with self.assertRaises(DbusNoReplyError):
+            await wait_for(
+                test_object_connection.slow_method.call_with_timeout(0.05),
+                timeout=1,
+            )
+
+        # Late reply to the timed out call does not affect the next one
+        self.assertEqual(
+            await wait_for(test_object_connection.slow_method(), timeout=1),
+            'done',
+        )
+
+    async def test_call_timeout_without_traffic(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        call_message = self.bus.new_method_call_message(
+            TEST_SERVICE_NAME, '/', 'org.test.test', 'LooongMethod')
+        call_message.timeout_usec = 50_000
+
+        # Nothing else is sent over the bus while the call is pending
+        loop = get_running_loop()
+        call_start = loop.time()
+        with self.assertRaises(DbusNoReplyError):
+            await wait_for(self.bus.call_async(call_message), timeout=2)
+
+        self.assertLess(loop.time() - call_start, 0.5)
+
+    async def test_call_cancel(self) -> None:
+        test_object, test_object_connection = initialize_object()
+
+        loop = get_running_loop()
+        loop_errors: List[Dict[str, Any]] = []
+        loop.set_exception_handler(
+            lambda _, context: loop_errors.append(context))
+
+        cancelled_call = loop.create_task(
+            test_object_connection.slow_method())
+        done_calls: List[Task[str]] = []
+        cancelled_call.add_done_callback(done_calls.append)
+        await sleep(0)
+        cancelled_call.cancel()
+        with self.assertRaises(CancelledError):
+            await cancelled_call
+
+        await wait_for(test_object.slow_reply_sync.wait(), timeout=1)
+        # Replies arrive in order so the cancelled call reply
+        # has been read by the time this call returns.
+        self.assertEqual(
+            await wait_for(test_object_connection.upper('test'), timeout=1),
+            'TEST',
+        )
+
+        self.assertTrue(cancelled_call.cancelled())
+        self.assertEqual(done_calls, [cancelled_call])
+        self.assertEqual(loop_errors, [])
+
     async def test_interface_remove(self) -> None:
         test_object, test_object_connection = initialize_object()
 
@@ -0,0 +1,144 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+
+# Copyright (C) 2020, 2021 igo95862
+
+# This file is part of python-sdbus
+
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+
+# Compares the speed of several builds of the sd_bus_internals extension.
+# For example the full API module against the stable API modules
+# built by meson:
+#
+#   dbus-run-session -- python3 tools/benchmark_extension.py \
+#       build/src/sdbus/sd_bus_internals.so \
+#       build/src/sdbus/sd_bus_internals_stable.so \
+#       build/src/sdbus/sd_bus_internals_stable_310.so
+#
+# Each module is measured in a separate process because the extension
+# can only be initialized once per interpreter.
+from __future__ import annotations
+
+from argparse import ArgumentParser
+from importlib.machinery import ExtensionFileLoader
+from importlib.util import module_from_spec, spec_from_loader
+from json import dumps, loads
+from subprocess import run
+from sys import executable
+from timeit import repeat
+from types import ModuleType
+from typing import Callable, Dict, List
+
+APPEND_SIGNATURE = 'sa{sv}as'
+APPEND_DATA = (
+    'org.example.Test',
+    {
+        'Name': ('s', 'test'),
+        'Size': ('t', 2 ** 40),
+        'Enabled': ('b', True),
+    },
+    [f"item_{i}" for i in range(32)],
+)
+
+
+def load_module(module_path: str) -> ModuleType:
+    loader = ExtensionFileLoader('sd_bus_internals', module_path)
+    spec = spec_from_loader('sd_bus_internals', loader)
+    assert spec is not None
+    module = module_from_spec(spec)
+    loader.exec_module(module)
+    return module
+
+
+def create_benchmarks(module: ModuleType) -> Dict[str, Callable[[], None]]:
+    bus = module.sd_bus_open_user()
+
+    def new_message() -> None:
+        bus.new_method_call_message(
+            'org.example.test', '/', 'org.example.Test', 'Test')
+
+    def append_data() -> None:
+        message = bus.new_method_call_message(
+            'org.example.test', '/', 'org.example.Test', 'Test')
+        message.append_data(APPEND_SIGNATURE, *APPEND_DATA)
+
+    # Messages can not be rewound so every read needs a new message.
+    def append_and_read() -> None:
+        message = bus.new_method_call_message(
+            'org.example.test', '/', 'org.example.Test', 'Test')
+        message.append_data(APPEND_SIGNATURE, *APPEND_DATA)
+        message.seal()
+        message.get_contents()
+
+    def validate_path() -> None:
+        module.is_object_path_valid('/org/example/test')
+
+    return {
+        'new_method_call_message': new_message,
+        'append_data': append_data,
+        'append_and_read': append_and_read,
+        'is_object_path_valid': validate_path,
+    }
+
+
+def measure_module(module_path: str, number: int) -> Dict[str, float]:
+    benchmarks = create_benchmarks(load_module(module_path))
+
+    return {
+        name: min(repeat(func, number=number, repeat=5)) / number
+        for name, func in benchmarks.items()
+    }
+
+
+def main() -> None:
+    arg_parser = ArgumentParser()
+    arg_parser.add_argument('module_paths', nargs='+')
+    arg_parser.add_argument('--number', type=int, default=20000)
+    arg_parser.add_argument('--measure-single', action='store_true')
+    args = arg_parser.parse_args()
+
+    module_paths: List[str] = args.module_paths
+    number: int = args.number
+
+    if args.measure_single:
+        print(dumps(measure_module(module_paths[0], number)))
+        return
+
+    results: List[Dict[str, float]] = []
+    for module_path in module_paths:
+        measure_process = run(
+            args=(
+                executable, __file__, '--measure-single',
+                '--number', str(number),
+                module_path,
+            ),
+            check=True,
+            capture_output=True,
+            text=True,
+        )
+        results.append(loads(measure_process.stdout))
+
+    for name in results[0]:
+        print(name)
+        baseline = results[0][name]
+        for module_path, result in zip(module_paths, results):
+            print(
+                f"  {result[name] * 1e9:10.0f} ns "
+                f"{result[name] / baseline:6.2f}x  {module_path}"
+            )
+
+
+if __name__ == '__main__':
+    main()